@@ -17,5 +17,8 @@ void main()  {
 
     // outFragColor = vec4(inColor * lightValue * sceneData.sunlightColor.w + sceneData.ambientColor.rgb, 1.0f);
 
-    outFragColor = vec4(inColor * lightValue * sceneData.sunlightColor.w + sceneData.ambientColor.rgb, 1.0f);
+    vec4 texColor = texture(sampler2D(textures[nonuniformEXT(PushConstants.textureIndex)],
+                                      samplers[nonuniformEXT(PushConstants.samplerIndex)]), inUV);
+
+    outFragColor = vec4(inColor * texColor.rgb * lightValue * sceneData.sunlightColor.w + sceneData.ambientColor.rgb, 1.0f);
 }
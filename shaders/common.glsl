@@ -1,3 +1,6 @@
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
+
 // uniform block
 layout(set = 0, binding = 0) uniform SceneData{   
 
@@ -9,12 +12,33 @@ layout(set = 0, binding = 0) uniform SceneData{
 	vec4 sunlightColor;
 } sceneData;
 
-layout(set = 1, binding = 0) uniform GLTFMaterialData{   
+// bindless heap, indexed with the handles from the push constants
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+layout(set = 1, binding = 2) readonly buffer StorageBuffer {
+	uint data[];
+} storageBuffers[];
+
+struct Vertex {
+	vec3 position;
+	float uv_x;
+	vec3 normal;
+	float uv_y;
+	vec4 color;
+}; 
 
-	vec4 colorFactors;
-	vec4 metal_rough_factors;
-	
-} materialData;
+// if we were in C: const VertexBuffer* vertices;
+// we are declaring a readonly buffer reference (pointer) to the vertex buffer
+// buffer_reference in the layout is what makes this buffer a pointer
+layout(buffer_reference, std430) readonly buffer VertexBuffer { 
+	Vertex vertices[];
+};
 
-layout(set = 1, binding = 1) uniform sampler2D colorTex;
-layout(set = 1, binding = 2) uniform sampler2D metalRoughTex;
+// push constant block
+layout( push_constant ) uniform constants
+{	
+	mat4 render_matrix;
+	VertexBuffer vertexBuffer;
+	uint textureIndex;
+	uint samplerIndex;
+} PushConstants;
@@ -0,0 +1,12 @@
+#version 450
+
+// bound while the mesh pipeline compiles, vertex colors without texturing or lighting
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() {
+	outFragColor = vec4(inColor, 1.0f);
+}
@@ -34,6 +34,12 @@ public:
 
 	void removeEntity(entt::entity entity) { m_entities.destroy(entity); }
 
+	// creates the pool of T up front, views of it then only read the registry, e.g. from systems running in parallel
+	template <typename T>
+	void reserveComponent() {
+		m_entities.storage<T>();
+	}
+
 protected:
 	entt::registry m_entities;
 };
@@ -51,6 +57,7 @@ public:
 	}
 
 	VkeScene& getCurrentScene() { return *currentScene; }
+	bool hasCurrentScene() { return currentScene != nullptr; }
 
 private:
 	std::shared_ptr<VkeScene> currentScene;
@@ -3,45 +3,131 @@
 #include "../renderer/vke_images.hpp"
 #include "../renderer/vke_initializers.hpp"
 
+#include <algorithm>
+#include <fstream>
+
 using namespace vke;
 
+// binary PPM, the half float channels are clamped to [0, 1]
+static VkResult writeReadback(const char* path, const FrameReadback& readback) {
+	if (readback.format != VK_FORMAT_R16G16B16A16_SFLOAT)
+		return VK_ERROR_FORMAT_NOT_SUPPORTED;
+
+	const uint32_t* texels = (const uint32_t*)readback.data;
+	size_t texelCount = (size_t)readback.extent.width * readback.extent.height;
+
+	std::vector<uint8_t> pixels(texelCount * 3);
+	for (size_t i = 0; i < texelCount; i++) {
+		glm::vec2 rg = glm::unpackHalf2x16(texels[i * 2]);
+		glm::vec2 ba = glm::unpackHalf2x16(texels[i * 2 + 1]);
+
+		pixels[i * 3] = (uint8_t)(glm::clamp(rg.x, 0.f, 1.f) * 255.f + 0.5f);
+		pixels[i * 3 + 1] = (uint8_t)(glm::clamp(rg.y, 0.f, 1.f) * 255.f + 0.5f);
+		pixels[i * 3 + 2] = (uint8_t)(glm::clamp(ba.x, 0.f, 1.f) * 255.f + 0.5f);
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	file << fmt::format("P6\n{} {}\n255\n", readback.extent.width, readback.extent.height);
+	file.write((const char*)pixels.data(), pixels.size());
+	file.close();
+
+	return file.fail() ? VK_ERROR_INITIALIZATION_FAILED : VK_SUCCESS;
+}
+
+// the first "{}" becomes the frame number, the rest of the path is taken as it is
+static std::string formatReadbackPath(const char* pattern, uint32_t frame) {
+	std::string path = pattern;
+	if (size_t index = path.find("{}"); index != std::string::npos)
+		path.replace(index, 2, std::to_string(frame));
+
+	return path;
+}
+
 void VkEngine::init(GameEngineSettings settings) {
-	VK_CHECK(m_window.init(settings.appName, settings.windowWidth, settings.windowHeight));
+	m_headless = settings.headless;
+	m_frameLimit = settings.frameLimit;
+	m_readbackPath = settings.readbackPath;
+	m_dumpFrameGraph = settings.dumpFrameGraph;
+	m_measurePipelineWarmup = settings.measurePipelineWarmup;
 
-	VK_CHECK(m_device.init(&m_window));
+	VkExtent2D drawExtent = {settings.windowWidth, settings.windowHeight};
 
-	m_swapchain.init(&m_device, m_window.getExtent(), VK_FORMAT_B8G8R8A8_UNORM);
+	// the thread calling init becomes the main thread of the job system, the one that submits to the queues
+	uint32_t cores = std::thread::hardware_concurrency();
+	m_jobSystem.init(cores > 1 ? cores - 1 : 1);
 
-	std::vector<VkeDescriptorAllocator::PoolSizeRatio> frameSizes = {
-		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3},
-		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3},
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
-	};
+	if (!m_headless) {
+		VK_CHECK(m_window.init(settings.appName, settings.windowWidth, settings.windowHeight));
+		drawExtent = m_window.getExtent();
+	}
+
+	VK_CHECK(m_device.init(m_headless ? nullptr : &m_window, &m_jobSystem, settings.pipelineCachePath, settings.shaderArchivePath));
+
+	if (!m_headless)
+		m_swapchain.init(&m_device, m_window.getExtent(), VK_FORMAT_B8G8R8A8_UNORM);
+
+	VK_CHECK(m_device.createBuffer(FRAME_DATA_SIZE * FRAME_OVERLAP,
+								   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+								   VMA_MEMORY_USAGE_CPU_TO_GPU, &m_frameDataBuffer));
 
 	for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
-		VK_CHECK(m_device.createCommandPool(&m_frames[i]._commandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT));
+		VK_CHECK(m_device.initLinearAllocator(&m_frames[i]._linearAllocator, &m_frameDataBuffer, i * FRAME_DATA_SIZE,
+											  FRAME_DATA_SIZE));
+
+		VK_CHECK(m_device.createCommandPool(&m_frames[i]._commandPool, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT));
 		VK_CHECK(m_device.allocateCommandBuffer(&m_frames[i]._commandBuffer, m_frames[i]._commandPool));
+		VK_CHECK(m_device.allocateCommandBuffer(&m_frames[i]._acquireCommandBuffer, m_frames[i]._commandPool));
+
+		m_frames[i]._threadCommands.resize(m_jobSystem.getThreadCount());
+		for (ThreadCommands& commands : m_frames[i]._threadCommands)
+			VK_CHECK(m_device.createCommandPool(&commands._commandPool, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT));
 
 		VK_CHECK(m_device.createSemaphore(&m_frames[i]._swapchainSemaphore));
 		VK_CHECK(m_device.createSemaphore(&m_frames[i]._renderSemaphore));
 		VK_CHECK(m_device.createFence(&m_frames[i]._renderFence, VK_FENCE_CREATE_SIGNALED_BIT));
 
-		VK_CHECK(m_device.initDescriptorPool(&m_frames[i]._descriptorAllocator, 100, frameSizes));
+		// 8 bytes per texel of the draw image
+		if (m_headless) {
+			VK_CHECK(m_device.createBuffer((size_t)drawExtent.width * drawExtent.height * 8, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+										   VMA_MEMORY_USAGE_GPU_TO_CPU, &m_frames[i]._readbackBuffer));
+		}
 	}
 
-	std::vector<VkeDescriptorAllocator::PoolSizeRatio> globalSizes = {
-		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
-	};
+	VK_CHECK(m_device.initGpuProfiler(&m_gpuProfiler, FRAME_OVERLAP));
+	for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+		m_gpuProfiler.initFrame(&m_frames[i]._gpuProfilerFrame, i);
+
+	m_frameClock.init(settings.fixedTimestep, settings.maxFixedSteps);
 
-	VK_CHECK(m_device.initDescriptorPool(&m_globalDescriptorAllocator, 10, globalSizes));
+	m_systemManager.init(&m_jobSystem);
 
-	VK_CHECK(m_device.createDrawImage(m_window.getExtent(), &m_drawImage));
+	m_gpuTracePath = settings.gpuTracePath;
+	m_cpuTracePath = settings.cpuTracePath;
+
+	VK_CHECK(m_device.createDrawImage(drawExtent, &m_drawImage));
+	m_device.initRenderGraph(&m_frameGraph);
 
 	initPipelines();
 	initTestData();
 
-	fmt::println("Engine initialized");
+	// compiled .spv files land next to the ones loaded by initPipelines
+	if (settings.shaderSourceDir && m_shaderWatcher.init(settings.shaderSourceDir, "shaders") != VK_SUCCESS)
+		fmt::println("Cannot watch {}, shader hot reload is disabled", settings.shaderSourceDir);
+
+	VkePipelineCache::Stats pipelineStats = m_device.getPipelineCacheStats();
+	fmt::println("{} pipelines compiled in {:.2f} ms, {} cache hits ({})", pipelineStats.pipelines, pipelineStats.totalMs,
+				 pipelineStats.cacheHits,
+				 pipelineStats.loadedFromDisk ? fmt::format("{} bytes loaded from disk", pipelineStats.loadedBytes)
+											  : "cold cache");
+
+	VkePipelineRegistry::Stats registryStats = m_device.getPipelineRegistryStats();
+	fmt::println("{} unique pipelines for {} requests, {} unique layouts for {} requests", registryStats.uniquePipelines,
+				 registryStats.pipelineRequests, registryStats.uniqueLayouts, registryStats.layoutRequests);
+
+	fmt::println("Engine initialized{}", m_headless ? ", headless" : "");
 
 	m_initiliazed = true;
 }
@@ -51,17 +137,7 @@ void VkEngine::initPipelines() {
 	VK_CHECK(m_device.createShader(m_fragmentShader, "shaders/basic.frag.spv"));
 	VK_CHECK(m_device.createShader(m_computeShader, "shaders/basic.comp.spv"));
 
-	auto bufferRange = vkutil::getPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(GPUDrawPushConstants));
-
-	m_globalSceneDescriptor.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	VK_CHECK(
-		m_device.initDescriptorSetLayout(&m_globalSceneDescriptor, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT));
-
-	m_materialDescriptor.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	m_materialDescriptor.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	m_materialDescriptor.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	VK_CHECK(m_device.initDescriptorSetLayout(&m_materialDescriptor, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT));
-
+	// the descriptor layouts and push constant ranges follow what the shaders declare
 	m_meshPipeline.setShaders(m_vertexShader, m_fragmentShader)
 		.setInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
 		.setPolygonMode(VK_POLYGON_MODE_FILL)
@@ -70,139 +146,480 @@ void VkEngine::initPipelines() {
 		.disableBlending()
 		.disableDepthTest()
 		.setColorAttachmentFormat(m_drawImage.imageFormat)
-		.setPushConstantRange(bufferRange)
-		.setDescriptorSet(m_globalSceneDescriptor);
-	// .setDescriptorSet(m_materialDescriptor);
+		.setDescriptorSet(m_globalSceneDescriptor)
+		.setDescriptorSet(m_device.getBindlessHeap().getDescriptor())
+		.setName("mesh");
+
+	m_globalSceneDescriptor.addBindings(m_meshPipeline.getReflection().getSetBindings(0), true);
+	VK_CHECK(
+		m_device.initDescriptorSetLayout(&m_globalSceneDescriptor, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT));
 
-	m_drawImageDescriptor.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	m_computePipeline.setShader(m_computeShader).setDescriptorSet(m_drawImageDescriptor).setName("gradient");
+
+	m_drawImageDescriptor.addBindings(m_computePipeline.getReflection().getSetBindings(0));
 	VK_CHECK(m_device.initDescriptorSetLayout(&m_drawImageDescriptor, VK_SHADER_STAGE_COMPUTE_BIT));
 
-	m_drawImageDescriptor.writeImage(0, m_drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
-	VK_CHECK(m_device.allocateDescriptorSet(&m_drawImageDescriptor, &m_globalDescriptorAllocator));
+	// both sets are written by the passes binding them and come from the descriptor cache, which hands back the same set
+	// for as long as the writes stay the same
+
+	// cheap stand-ins compiled right away, bound while the real pipelines compile; they share their layouts, so the
+	// fallback fragment shader gets the push constant range of the mesh pipeline even though it uses none of it
+	VkeShader fallbackFragmentShader, fallbackComputeShader;
+	VK_CHECK(m_device.createShader(fallbackFragmentShader, "shaders/fallback.frag.spv"));
+	VK_CHECK(m_device.createShader(fallbackComputeShader, "shaders/fallback.comp.spv"));
+
+	const VkeShaderReflection& meshReflection = m_meshPipeline.getReflection();
+	VkPushConstantRange meshPushConstants =
+		vkutil::getPushConstantRange(meshReflection.pushConstantStages, meshReflection.pushConstantSize);
+
+	VkeGraphicsPipeline fallbackMeshPipeline = m_meshPipeline;
+	fallbackMeshPipeline.setShaders(m_vertexShader, fallbackFragmentShader)
+		.setPushConstantRange(meshPushConstants)
+		.setName("mesh fallback");
+
+	VkeComputePipeline fallbackComputePipeline;
+	fallbackComputePipeline.setShader(fallbackComputeShader).setDescriptorSet(m_drawImageDescriptor).setName("gradient fallback");
 
-	m_computePipeline.setShader(m_computeShader).setDescriptorSet(m_drawImageDescriptor);
+	VK_CHECK(m_device.createGraphicsPipeline(fallbackMeshPipeline));
+	VK_CHECK(m_device.createComputePipeline(fallbackComputePipeline));
 
-	VK_CHECK(m_device.createGraphicsPipeline(m_meshPipeline));
-	VK_CHECK(m_device.createComputePipeline(m_computePipeline));
+	m_device.setFallbackPipeline(fallbackMeshPipeline);
+	m_device.setFallbackPipeline(fallbackComputePipeline);
+
+	VK_CHECK(m_device.destroyShader(fallbackFragmentShader));
+	VK_CHECK(m_device.destroyShader(fallbackComputeShader));
+
+	// compiled in parallel, the shader modules are only destroyed once every pipeline is ready
+	VkeGraphicsPipeline* graphicsPipelines[] = {&m_meshPipeline};
+	VkeComputePipeline* computePipelines[] = {&m_computePipeline};
+
+	if (m_measurePipelineWarmup) {
+		PipelineWarmupStats warmupStats;
+		VK_CHECK(m_device.warmupPipelines(graphicsPipelines, computePipelines, &warmupStats));
+
+		fmt::println("{} pipelines warmed up in {:.2f} ms ({} cache hits), {:.2f} ms when compiled serially without the cache",
+					 warmupStats.pipelines, warmupStats.wallMs, warmupStats.cacheHits, warmupStats.serialMs);
+	} else {
+		VK_CHECK(m_device.warmupPipelines(graphicsPipelines, computePipelines));
+	}
+
+	// the device keeps references of its own, the layouts stay with the real pipelines
+	m_device.releasePipeline(fallbackMeshPipeline, getCurrentFrame()._deletionQueue);
+	m_device.releasePipeline(fallbackComputePipeline, getCurrentFrame()._deletionQueue);
 
 	VK_CHECK(m_device.destroyShader(m_vertexShader));
 	VK_CHECK(m_device.destroyShader(m_fragmentShader));
 	VK_CHECK(m_device.destroyShader(m_computeShader));
 }
 
+void VkEngine::reloadShaders() {
+	// later changes wait for the current reload to be swapped in
+	if (m_device.isReloadPending()) {
+		m_device.applyPipelineReloads(getCurrentFrame()._deletionQueue);
+		return;
+	}
+
+	std::vector<std::string> compiled = m_shaderWatcher.takeCompiledShaders();
+	if (compiled.empty())
+		return;
+
+	std::vector<VkeShader*> reloaded;
+	for (VkeShader* shader : {&m_vertexShader, &m_fragmentShader, &m_computeShader}) {
+		if (std::find(compiled.begin(), compiled.end(), shader->getPath()) == compiled.end())
+			continue;
+
+		if (m_device.reloadShader(*shader) == VK_SUCCESS)
+			reloaded.push_back(shader);
+	}
+
+	auto usesReloaded = [&](VkePipeline& pipeline) {
+		return std::any_of(reloaded.begin(), reloaded.end(), [&](VkeShader* shader) { return pipeline.usesShader(*shader); });
+	};
+
+	// the current pipelines keep drawing until every replacement is compiled
+	if (usesReloaded(m_meshPipeline) && m_device.reloadGraphicsPipeline(m_meshPipeline) != VK_SUCCESS)
+		fmt::println("Failed to start reloading pipeline mesh");
+
+	if (usesReloaded(m_computePipeline) && m_device.reloadComputePipeline(m_computePipeline) != VK_SUCCESS)
+		fmt::println("Failed to start reloading pipeline gradient");
+}
+
 // TEMP: this should be the entry point of the engine for the user code
 void VkEngine::run() {
 	bool quit = false;
 
+	VKE_PROFILE_THREAD("main");
+
 	while (!quit) {
-		glfwPollEvents();
+		if (!m_headless) {
+			glfwPollEvents();
 
-		if (glfwWindowShouldClose(m_window.getWindow()))
-			quit = true;
+			if (glfwWindowShouldClose(m_window.getWindow()))
+				quit = true;
+		}
+
+		m_frameClock.tick();
+
+		// the simulation runs ahead of the frame, it does not touch the resources startFrame waits for
+		while (m_frameClock.consumeFixedStep())
+			m_systemManager.fixedUpdateAll(m_frameClock.getFixedStep());
 
 		startFrame();
 
 		// drawGeometryTest();
 		// m_sceneManager.update(0.0f);
-		m_systemManager.updateAll(0.0f);
+		m_systemManager.updateAll(m_frameClock.getDeltaTime());
 
 		endFrame();
+
+		VKE_PROFILE_FRAME();
+
+		if (m_frameLimit && m_frame >= (int)m_frameLimit)
+			quit = true;
+
+#ifdef VKE_PROFILING
+		// headless runs have no keyboard, their trace is written once they stop
+		bool traceKeyDown = m_headless ? quit : glfwGetKey(m_window.getWindow(), GLFW_KEY_F12) == GLFW_PRESS;
+		if (traceKeyDown && !m_traceKeyDown && m_cpuTracePath) {
+			if (VkeProfiler::writeChromeTrace(m_cpuTracePath) == VK_SUCCESS)
+				fmt::println("CPU trace written to {}", m_cpuTracePath);
+			else
+				fmt::println("Failed to write the CPU trace to {}", m_cpuTracePath);
+		}
+
+		m_traceKeyDown = traceKeyDown;
+#endif
+	}
+}
+
+void VkEngine::processReadback(FrameData& frame) {
+	if (frame._readbackFrame < 0)
+		return;
+
+	VK_CHECK(m_device.invalidateBuffer(&frame._readbackBuffer));
+
+	FrameReadback readback = {
+		.data = frame._readbackBuffer.info.pMappedData,
+		.extent = m_drawExtent,
+		.format = m_drawImage.imageFormat,
+		.frame = (uint32_t)frame._readbackFrame,
+	};
+
+	frame._readbackFrame = -1;
+
+	if (m_readbackCallback)
+		m_readbackCallback(readback);
+
+	if (m_readbackPath) {
+		// the buffer is reused two frames later, the worker converts and writes a copy while the frames go on
+		const uint8_t* data = (const uint8_t*)readback.data;
+		size_t size = (size_t)readback.extent.width * readback.extent.height * 8;
+		auto texels = std::make_shared<std::vector<uint8_t>>(data, data + size);
+
+		m_jobSystem.runBackground([path = formatReadbackPath(m_readbackPath, readback.frame), texels, readback]() mutable {
+			readback.data = texels->data();
+			if (writeReadback(path.c_str(), readback) != VK_SUCCESS)
+				fmt::println("Failed to write frame {} to {}", readback.frame, path);
+		});
 	}
 }
 
 void VkEngine::startFrame() {
-	VK_CHECK(vkWaitForFences(m_device.getDevice(), 1, &getCurrentFrame()._renderFence, true, 1000000000));
+	VKE_PROFILE_SCOPE("startFrame");
+
+	{
+		VKE_PROFILE_SCOPE("waitForFence");
+		VK_CHECK(vkWaitForFences(m_device.getDevice(), 1, &getCurrentFrame()._renderFence, true, 1000000000));
+	}
+
 	VK_CHECK(vkResetFences(m_device.getDevice(), 1, &getCurrentFrame()._renderFence));
 
-	getCurrentFrame()._deletionQueue.flush();
-	VK_CHECK(m_device.resetDescriptorPool(&getCurrentFrame()._descriptorAllocator));
+	m_jobSystem.runMainThreadJobs();
+	processReadback(getCurrentFrame());
+
+	m_device.flushDeletionQueue(getCurrentFrame()._deletionQueue);
+	reloadShaders();
+	getCurrentFrame()._linearAllocator.reset();
+	m_device.newFrame();
 
-	m_swapchain.acquireImage(getCurrentFrame()._swapchainSemaphore);
+	if (!m_headless) {
+		VKE_PROFILE_SCOPE("acquireImage");
+		m_swapchain.acquireImage(getCurrentFrame()._swapchainSemaphore);
+	}
 
-	VK_CHECK(vkResetCommandBuffer(currentCmd(), 0));
+	VK_CHECK(vkResetCommandPool(m_device.getDevice(), getCurrentFrame()._commandPool, 0));
+	for (ThreadCommands& commands : getCurrentFrame()._threadCommands) {
+		VK_CHECK(vkResetCommandPool(m_device.getDevice(), commands._commandPool, 0));
+		commands._used = 0;
+	}
 
 	m_drawExtent.width = m_drawImage.imageExtent.width;
 	m_drawExtent.height = m_drawImage.imageExtent.height;
 
 	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	VK_CHECK(vkBeginCommandBuffer(currentCmd(), &cmdBeginInfo));
+
+	m_gpuProfiler.beginFrame(currentCmd(), getCurrentFrame()._gpuProfilerFrame);
+
+	// the swapchain image is only usable once the acquire semaphore, waited at color output, is signaled
+	m_frameGraph.reset();
+	m_graphDrawImage = m_frameGraph.importImage("draw_image", m_drawImage);
+	if (!m_headless) {
+		m_graphSwapchainImage = m_frameGraph.importImage("swapchain", m_swapchain.getCurrentImage(),
+														 VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE);
+	}
 }
 
 void VkEngine::endFrame() {
-	vkutil::copyImageToImage(currentCmd(), m_drawImage, m_swapchain.getCurrentImage(), m_drawExtent, m_swapchain.getExtent());
-	vkutil::makePresentable(currentCmd(), m_swapchain.getCurrentImage());
+	VKE_PROFILE_SCOPE("endFrame");
+
+	addGeometryPass();
+
+	if (!m_headless) {
+		m_frameGraph.addPass("present")
+			.read(m_graphDrawImage, RenderGraphUsage::TransferSrc)
+			.write(m_graphSwapchainImage, RenderGraphUsage::TransferDst)
+			.setExecute([this](VkCommandBuffer cmd) {
+				VkeGpuProfiler::Scope scope(m_gpuProfiler, cmd, "present");
+				vkutil::copyImageToImage(cmd, m_drawImage.image, m_swapchain.getCurrentImage().image, m_drawExtent,
+										 m_swapchain.getExtent());
+			});
+		m_frameGraph.setFinalUsage(m_graphSwapchainImage, RenderGraphUsage::Present);
+	} else if (isReadbackEnabled()) {
+		FrameData& frame = getCurrentFrame();
+		RenderGraphBuffer readbackBuffer = m_frameGraph.importBuffer("readback", frame._readbackBuffer.buffer);
+
+		m_frameGraph.addPass("readback")
+			.read(m_graphDrawImage, RenderGraphUsage::TransferSrc)
+			.write(readbackBuffer, RenderGraphUsage::TransferDst)
+			.setExecute([this, buffer = frame._readbackBuffer.buffer](VkCommandBuffer cmd) {
+				VkeGpuProfiler::Scope scope(m_gpuProfiler, cmd, "readback");
+
+				VkBufferImageCopy region = {
+					.imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+					.imageExtent = {m_drawExtent.width, m_drawExtent.height, 1},
+				};
+
+				vkCmdCopyImageToBuffer(cmd, m_drawImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+				// the fence does not make the copy visible to the host on its own
+				VkMemoryBarrier2 hostBarrier = {
+					.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+					.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+					.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+					.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+					.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+				};
+
+				VkDependencyInfo dependencyInfo = {
+					.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+					.memoryBarrierCount = 1,
+					.pMemoryBarriers = &hostBarrier,
+				};
+
+				vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+			});
+
+		frame._readbackFrame = m_frame;
+	}
+
+	{
+		VKE_PROFILE_SCOPE("recordFrame");
+
+		VK_CHECK(m_frameGraph.compile(getCurrentFrame()._deletionQueue));
+		if (m_dumpFrameGraph && m_frame == 0)
+			fmt::print("{}", m_frameGraph.dump());
+
+		m_frameGraph.execute(currentCmd());
+		m_meshDraws.clear();
+	}
 
 	VK_CHECK(vkEndCommandBuffer(currentCmd()));
 
-	VkSemaphoreSubmitInfo waitInfo =
-		vkinit::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, getCurrentFrame()._swapchainSemaphore);
+	// recorded last so uploads submitted while the frame was built are acquired and waited for by this frame already,
+	// the acquire barriers run ahead of the frame's commands in the same submission
+	VkCommandBuffer acquireCmd = getCurrentFrame()._acquireCommandBuffer;
+	VkCommandBufferBeginInfo acquireBeginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(acquireCmd, &acquireBeginInfo));
+	VkSemaphoreSubmitInfo uploadWait = m_device.acquireUploads(acquireCmd);
+	VK_CHECK(vkEndCommandBuffer(acquireCmd));
+
+	VkSemaphoreSubmitInfo waitInfos[2] = {
+		uploadWait,
+		vkinit::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, getCurrentFrame()._swapchainSemaphore),
+	};
 	VkSemaphoreSubmitInfo signalInfo =
 		vkinit::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, getCurrentFrame()._renderSemaphore);
 
-	VkCommandBufferSubmitInfo cmdinfo = vkinit::commandBufferSubmitInfo(currentCmd());
-	VkSubmitInfo2 submitInfo = vkinit::submitInfo(&cmdinfo, &signalInfo, &waitInfo);
+	// headless frames only wait for their uploads and signal nothing but the fence
+	VkCommandBufferSubmitInfo cmdinfos[2] = {
+		vkinit::commandBufferSubmitInfo(acquireCmd),
+		vkinit::commandBufferSubmitInfo(currentCmd()),
+	};
+	VkSubmitInfo2 submitInfo = vkinit::submitInfo(cmdinfos, m_headless ? nullptr : &signalInfo, waitInfos);
+	submitInfo.waitSemaphoreInfoCount = m_headless ? 1 : 2;
+	submitInfo.commandBufferInfoCount = 2;
 
-	m_device.submitCommand(1, &submitInfo, getCurrentFrame()._renderFence);
-	m_swapchain.presentOnScreen(getCurrentFrame()._renderSemaphore);
+	{
+		VKE_PROFILE_SCOPE("submit");
+		m_device.submitCommand(1, &submitInfo, getCurrentFrame()._renderFence);
+	}
+
+	if (!m_headless) {
+		VKE_PROFILE_SCOPE("present");
+		m_swapchain.presentOnScreen(getCurrentFrame()._renderSemaphore);
+	}
 
 	m_frame++;
 }
 
+void VkEngine::drawMesh(const GPUMeshBuffers& mesh, const glm::mat4& worldMatrix, uint32_t textureIndex) {
+	m_meshDraws.push_back({._mesh = mesh, ._worldMatrix = worldMatrix, ._textureIndex = textureIndex});
+}
+
 void VkEngine::drawGeometryTest() {
-	// preparation
-	VkCommandBuffer cmd = currentCmd();
+	m_sceneData.sunlightColor = glm::vec4{1.f, 1.f, 1.f, 1.f};
 
-	vkutil::makeColorWriteable(cmd, m_drawImage);
-	VkRenderingAttachmentInfo colorAttachment = vkinit::attachmentInfo(m_drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
-	VkRenderingInfo renderInfo = vkinit::renderingInfo(m_drawExtent, &colorAttachment, nullptr);
+	drawMesh(m_testMesh, glm::mat4{1.f}, m_whiteTexture.bindlessIndex);
+}
 
-	vkCmdBeginRendering(cmd, &renderInfo);
+void VkEngine::addGeometryPass() {
+	if (m_meshDraws.empty())
+		return;
 
-	vkutil::setViewport(cmd, m_drawExtent);
-	vkutil::setScissor(cmd, m_drawExtent);
+	// global scene data
+	VkeLinearAllocator::Allocation sceneData;
+	VK_CHECK(getCurrentFrame()._linearAllocator.pushUniform(m_sceneData, &sceneData));
+
+	uint32_t sceneDataOffset = (uint32_t)sceneData.offset;
+
+	// every frame selects its scene data with a dynamic offset, the set itself stays the same
+	m_globalSceneDescriptor.writeBuffer(0, m_frameDataBuffer.buffer, sizeof(GPUSceneData), 0,
+										VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+	VK_CHECK(m_device.getCachedDescriptorSet(&m_globalSceneDescriptor));
+
+	// recorded when the graph executes, the barrier into the attachment layout comes from the graph
+	m_frameGraph.addPass("geometry")
+		.write(m_graphDrawImage, RenderGraphUsage::ColorAttachment)
+		.setExecute([this, sceneDataOffset](VkCommandBuffer cmd) {
+			VkeGpuProfiler::Scope scope(m_gpuProfiler, cmd, "geometry");
+
+			VkRenderingAttachmentInfo colorAttachment = vkinit::attachmentInfo(m_drawImage.imageView, nullptr);
+			VkRenderingInfo renderInfo = vkinit::renderingInfo(m_drawExtent, &colorAttachment, nullptr);
+
+			// resolved once here, the recording threads must not touch a compile that is still pending
+			VkPipeline pipeline = m_meshPipeline.resolve();
+			uint32_t drawCount = (uint32_t)m_meshDraws.size();
+
+			if (drawCount < MIN_DRAWS_PER_SECONDARY * 2) {
+				vkCmdBeginRendering(cmd, &renderInfo);
+				recordDraws(cmd, pipeline, sceneDataOffset, 0, drawCount);
+				vkCmdEndRendering(cmd);
+				return;
+			}
+
+			// two ranges per thread so the ones finishing early steal the rest, each range is a secondary of its own
+			uint32_t threadCount = m_jobSystem.getThreadCount();
+			uint32_t grain = std::max(MIN_DRAWS_PER_SECONDARY, (drawCount + threadCount * 2 - 1) / (threadCount * 2));
+			std::vector<VkCommandBuffer> secondaries((drawCount + grain - 1) / grain);
+
+			VkCommandBufferInheritanceRenderingInfo renderingInheritance = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+				.colorAttachmentCount = 1,
+				.pColorAttachmentFormats = &m_drawImage.imageFormat,
+				.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+			};
+
+			VkCommandBufferInheritanceInfo inheritance = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+				.pNext = &renderingInheritance,
+			};
+
+			// the jobs reference the inheritance info and the secondaries on this stack, parallelFor only returns once the
+			// last of them is done with its counter too
+			m_jobSystem.parallelFor(0, drawCount, grain, [&](uint32_t first, uint32_t last) {
+				VKE_PROFILE_SCOPE("recordDraws");
+
+				VkCommandBuffer secondary = beginSecondary(inheritance);
+				recordDraws(secondary, pipeline, sceneDataOffset, first, last);
+				VK_CHECK(vkEndCommandBuffer(secondary));
+
+				secondaries[first / grain] = secondary;
+			});
+
+			// executed in draw order, whichever thread recorded them
+			renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+			vkCmdBeginRendering(cmd, &renderInfo);
+			vkCmdExecuteCommands(cmd, (uint32_t)secondaries.size(), secondaries.data());
+			vkCmdEndRendering(cmd);
+		});
+}
 
-	m_sceneData.sunlightColor = glm::vec4{1.f, 1.f, 1.f, 1.f};
+VkCommandBuffer VkEngine::beginSecondary(const VkCommandBufferInheritanceInfo& inheritance) {
+	// only the owning thread allocates from and records into a pool, none of them needs a lock
+	ThreadCommands& commands = getCurrentFrame()._threadCommands[m_jobSystem.getThreadIndex()];
 
-	// global scene data
-	AllocatedBuffer gpuSceneDataBuffer;
-	VK_CHECK(m_device.createBuffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
-								   &gpuSceneDataBuffer, true));
+	if (commands._used == commands._secondaries.size()) {
+		VK_CHECK(m_device.allocateCommandBuffer(&commands._secondaries.emplace_back(), commands._commandPool,
+												VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+	}
 
-	VK_CHECK(m_device.fillBuffer(&gpuSceneDataBuffer, &m_sceneData, sizeof(GPUSceneData)));
+	VkCommandBuffer cmd = commands._secondaries[commands._used++];
 
-	m_globalSceneDescriptor.writeBuffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+	VkCommandBufferBeginInfo beginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+																		VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+	beginInfo.pInheritanceInfo = &inheritance;
+	VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
 
-	VK_CHECK(m_device.allocateDescriptorSet(&m_globalSceneDescriptor, &getCurrentFrame()._descriptorAllocator, true));
+	return cmd;
+}
 
-	getCurrentFrame()._deletionQueue.push_function(
-		[this, gpuSceneDataBuffer]() mutable { m_device.destroyBuffer(&gpuSceneDataBuffer); });
+void VkEngine::recordDraws(VkCommandBuffer cmd, VkPipeline pipeline, uint32_t sceneDataOffset, uint32_t first, uint32_t last) {
+	// secondaries inherit none of the state, every buffer sets it up again
+	vkutil::setViewport(cmd, m_drawExtent);
+	vkutil::setScissor(cmd, m_drawExtent);
 
-	// push constants for matrices and vertex buffer address
-	GPUDrawPushConstants push_constants;
-	push_constants.worldMatrix = glm::mat4{1.f};
-	push_constants.vertexBuffer = m_testMesh.vertexBufferAddress;
-	m_meshPipeline.pushConstants(cmd, &push_constants);
+	// every mesh lives in the geometry arena, the pipeline and the index buffer are bound once
+	m_meshPipeline.bind(cmd, pipeline, {&sceneDataOffset, 1});
 
-	m_meshPipeline.bind(cmd);
+	m_device.bindGeometryArena(cmd);
 
-	vkCmdBindIndexBuffer(cmd, m_testMesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	for (uint32_t i = first; i < last; i++) {
+		const MeshDraw& draw = m_meshDraws[i];
 
-	vkCmdDrawIndexed(cmd, 6, 1, 0, 0, 0);
+		// push constants for matrices and vertex buffer address
+		GPUDrawPushConstants push_constants;
+		push_constants.worldMatrix = draw._worldMatrix;
+		push_constants.vertexBuffer = draw._mesh.vertexBufferAddress;
+		push_constants.textureIndex = draw._textureIndex;
+		push_constants.samplerIndex = m_defaultSamplerNearestIndex;
+		m_meshPipeline.pushConstants(cmd, &push_constants, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 
-	vkCmdEndRendering(cmd);
+		vkCmdDrawIndexed(cmd, draw._mesh.indexCount, 1, draw._mesh.firstIndex, draw._mesh.vertexOffset, 0);
+	}
 }
 
 void VkEngine::drawComputeTest() {
-	VkCommandBuffer cmd = currentCmd();
+	m_drawImageDescriptor.writeImage(0, m_drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
+	VK_CHECK(m_device.getCachedDescriptorSet(&m_drawImageDescriptor));
 
-	vkutil::makeWriteable(cmd, m_drawImage);
+	m_frameGraph.addPass("gradient")
+		.write(m_graphDrawImage, RenderGraphUsage::ComputeStorage)
+		.setExecute([this](VkCommandBuffer cmd) {
+			VkeGpuProfiler::Scope scope(m_gpuProfiler, cmd, "gradient");
 
-	m_computePipeline.bind(cmd);
+			m_computePipeline.bind(cmd);
 
-	vkCmdDispatch(cmd, m_drawImage.imageExtent.width, m_drawImage.imageExtent.height, 1);
+			// one invocation per pixel, rounded up to whole workgroups
+			const uint32_t* localSize = m_computePipeline.getReflection().localSize;
+			vkCmdDispatch(cmd, (m_drawImage.imageExtent.width + localSize[0] - 1) / localSize[0],
+						  (m_drawImage.imageExtent.height + localSize[1] - 1) / localSize[1], 1);
+		});
 }
 
 void VkEngine::initTestData() {
+	m_device.beginUploadBatch();
+
 	std::array<Vertex, 4> rect_vertices;
 
 	rect_vertices[0].position = {0.5, -0.5, 0};
@@ -235,32 +652,67 @@ void VkEngine::initTestData() {
 	VK_CHECK(m_device.createFilledImage(&m_checkboardTexture, pixels.data(), {16, 16, 1}, VK_FORMAT_R8G8B8A8_UNORM,
 										VK_IMAGE_USAGE_SAMPLED_BIT));
 
+	VK_CHECK(m_device.endUploadBatch());
+
 	VkSamplerCreateInfo sampl = {
 		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
 		.magFilter = VK_FILTER_NEAREST,
 		.minFilter = VK_FILTER_NEAREST,
 	};
 
-	VK_CHECK(m_device.createSampler(&m_defaultSamplerNearest, &sampl));
+	VK_CHECK(m_device.createSampler(&m_defaultSamplerNearest, &sampl, &m_defaultSamplerNearestIndex));
 
 	sampl.magFilter = VK_FILTER_LINEAR;
 	sampl.minFilter = VK_FILTER_LINEAR;
-	VK_CHECK(m_device.createSampler(&m_defaultSamplerLinear, &sampl));
+	VK_CHECK(m_device.createSampler(&m_defaultSamplerLinear, &sampl, &m_defaultSamplerLinearIndex));
 }
 
 void VkEngine::destroy() {
 	if (!m_initiliazed)
 		return;
 
+	m_shaderWatcher.destroy();
+
 	m_device.waitIdle();
 
+	// oldest first, the callback sees the frames in order
+	for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+		processReadback(m_frames[(m_frame + i) % FRAME_OVERLAP]);
+
+	// runs what is still queued first, pipeline compiles use the device and readbacks still have to be written
+	m_jobSystem.destroy();
+
 	for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
-		m_frames[i]._deletionQueue.flush();
+		m_device.flushDeletionQueue(m_frames[i]._deletionQueue);
 	}
 
-	m_swapchain.destroy();
+	m_device.destroyRenderGraph(&m_frameGraph);
+
+	// oldest first, the trace stays in frame order
+	for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+		m_gpuProfiler.collectFrame(m_frames[(m_frame + i) % FRAME_OVERLAP]._gpuProfilerFrame);
+
+	VkeFrameClock::Stats frameStats = m_frameClock.getStats();
+	if (frameStats.samples) {
+		fmt::println("Frame time: avg {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms over the last {} frames",
+					 frameStats.avgMs, frameStats.p95Ms, frameStats.p99Ms, frameStats.maxMs, frameStats.samples);
+	}
+
+	for (const VkeGpuProfiler::ScopeStats& stats : m_gpuProfiler.getStats()) {
+		fmt::println("GPU {}: min {:.3f} ms, avg {:.3f} ms, p99 {:.3f} ms over the last {} frames", stats.name, stats.minMs,
+					 stats.avgMs, stats.p99Ms, stats.samples);
+	}
+
+	if (m_gpuTracePath && m_gpuProfiler.writeChromeTrace(m_gpuTracePath) != VK_SUCCESS)
+		fmt::println("Failed to write the GPU trace to {}", m_gpuTracePath);
+
+	m_device.destroyGpuProfiler(&m_gpuProfiler);
+
+	if (!m_headless)
+		m_swapchain.destroy();
 
 	m_device.destroy();
 
-	m_window.destroy();
+	if (!m_headless)
+		m_window.destroy();
 }
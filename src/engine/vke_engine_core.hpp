@@ -7,6 +7,9 @@
 #include "../renderer/vke_utils.hpp"
 #include "../renderer/vke_window.hpp"
 #include "../renderer/vke_pipelines.hpp"
+#include "../renderer/vke_shader_watcher.hpp"
+#include "vke_frame_clock.hpp"
+#include "vke_profiler.hpp"
 #include "../assets/vke_scene.hpp"
 #include "../systems/vke_system_manager.hpp"
 
@@ -17,18 +20,60 @@ struct GameEngineSettings {
 	uint32_t windowWidth = 1280;
 	uint32_t windowHeight = 720;
 	bool resizableWindow = false;
+	const char* pipelineCachePath = "pipeline_cache.bin";
+	const char* shaderArchivePath = "shaders/shaders.pak";
+	const char* shaderSourceDir = "shaders"; // watched for hot reload, nullptr disables it; the demo does for headless runs
+	const char* gpuTracePath = nullptr; // Chrome trace of the GPU scopes, written on exit
+	const char* cpuTracePath = "cpu_trace.json"; // F12 writes the CPU zones of the last frames there, headless runs on exit
+	bool headless = false; // no window or swapchain, frames stay in the draw image
+	uint32_t frameLimit = 0; // run returns after that many frames, 0 keeps going until the window is closed
+	const char* readbackPath = nullptr; // headless frames written there as PPM by a worker, "{}" becomes the frame number
+	double fixedTimestep = 1.0 / 60.0; // seconds per fixedUpdate of the systems
+	uint32_t maxFixedSteps = 5; // per frame, time beyond that is dropped so a hitch cannot snowball
+	bool dumpFrameGraph = false; // prints the passes and barriers of the first frame
+	bool measurePipelineWarmup = false; // compiles the startup pipelines a second time, serially, to compare
+};
+
+// draw image of a finished headless frame, only valid during the readback callback
+struct FrameReadback {
+	const void* data; // tightly packed rows
+	VkExtent2D extent;
+	VkFormat format;
+	uint32_t frame;
+};
+
+// queued by drawMesh, recorded when the frame ends
+struct MeshDraw {
+	GPUMeshBuffers _mesh;
+	glm::mat4 _worldMatrix;
+	uint32_t _textureIndex;
+};
+
+// command pool of one job system thread, its secondaries are reused once the pool is reset
+struct ThreadCommands {
+	VkCommandPool _commandPool;
+	std::vector<VkCommandBuffer> _secondaries;
+	uint32_t _used; // handed out since the last reset
 };
 
 struct FrameData {
 	VkSemaphore _swapchainSemaphore, _renderSemaphore;
 	VkFence _renderFence;
 
+	// every pool of the frame is reset as a whole in startFrame, once the fence says nothing recorded from it is in flight
 	VkCommandPool _commandPool;
 	VkCommandBuffer _commandBuffer;
+	VkCommandBuffer _acquireCommandBuffer; // ownership acquires of the uploads, submitted just before _commandBuffer
+	std::vector<ThreadCommands> _threadCommands; // indexed by job system thread
 
 	vkutil::DeletionQueue _deletionQueue;
 
-	VkeDescriptorAllocator _descriptorAllocator; // TODO: make growable
+	VkeLinearAllocator _linearAllocator; // uniform and storage data written this frame
+
+	VkeGpuProfiler::Frame _gpuProfilerFrame; // timestamps of the frame, read back when the slot comes around again
+
+	AllocatedBuffer _readbackBuffer; // headless only, the draw image is copied there
+	int _readbackFrame{-1}; // frame waiting in the buffer, read once the slot's fence has been waited on
 };
 
 class VkEngine {
@@ -41,17 +86,36 @@ public:
 	int m_frame{0};
 
 	static constexpr unsigned int FRAME_OVERLAP = 2;
+	static constexpr VkDeviceSize FRAME_DATA_SIZE = 1024 * 1024;
+	static constexpr uint32_t MIN_DRAWS_PER_SECONDARY = 512; // fewer draws are recorded inline into the frame's buffer
 
 	void init(GameEngineSettings settings = defaultSettings);
 	void run();
 	void destroy();
 
+	// headless frames are handed over when their slot comes around again, so reading them back never stalls
+	void setReadbackCallback(std::function<void(const FrameReadback&)>&& callback) { m_readbackCallback = callback; }
+
+	// queued for the current frame, every draw is recorded in one geometry pass once the frame ends
+	void drawMesh(const GPUMeshBuffers& mesh, const glm::mat4& worldMatrix, uint32_t textureIndex);
+
+	// interpolation alpha between the last two fixed steps, for rendering what the fixed updates simulate
+	float getInterpolationAlpha() { return m_frameClock.getAlpha(); }
+	VkeFrameClock& getFrameClock() { return m_frameClock; }
+	VkeFrameClock::Stats getFrameStats() { return m_frameClock.getStats(); }
+	const SystemScheduleStats& getSystemStats() { return m_systemManager.getStats(); } // of the last frame
+
+	VkeDevice& getDevice() { return m_device; }
+	VkeJobSystem& getJobSystem() { return m_jobSystem; }
+	VkeGpuProfiler& getGpuProfiler() { return m_gpuProfiler; }
+
 	void drawGeometryTest();
 	void drawComputeTest();
 	void initTestData();
 
 	std::shared_ptr<VkeScene> createScene(const std::string& name) { return m_sceneManager.registerAsset(name); }
 	VkeScene& getCurrentScene() { return m_sceneManager.getCurrentScene(); }
+	bool hasCurrentScene() { return m_sceneManager.hasCurrentScene(); }
 	void switchScene(const std::string& name) { m_sceneManager.switchScene(name); }
 
 	template <typename T>
@@ -81,16 +145,34 @@ public:
 	AllocatedImage m_checkboardTexture;
 	VkSampler m_defaultSamplerLinear;
 	VkSampler m_defaultSamplerNearest;
+	uint32_t m_defaultSamplerLinearIndex; // bindless handles of the default samplers
+	uint32_t m_defaultSamplerNearestIndex;
 
 private:
+	VkeJobSystem m_jobSystem;
 	VkeWindow m_window;
 	VkeDevice m_device;
 	VkeSwapchain m_swapchain;
 
+	bool m_headless;
+	uint32_t m_frameLimit;
+	const char* m_readbackPath;
+	bool m_dumpFrameGraph;
+	bool m_measurePipelineWarmup;
+	std::function<void(const FrameReadback&)> m_readbackCallback;
+
 	AllocatedImage m_drawImage;
 	VkExtent2D m_drawExtent;
 
+	VkeRenderGraph m_frameGraph; // rebuilt every frame, user passes go between startFrame and endFrame
+	RenderGraphImage m_graphDrawImage;
+	RenderGraphImage m_graphSwapchainImage;
+
+
+	std::vector<MeshDraw> m_meshDraws;
+
 	FrameData m_frames[FRAME_OVERLAP];
+	AllocatedBuffer m_frameDataBuffer; // backs the linear allocators of every frame
 	FrameData& getCurrentFrame() { return m_frames[m_frame % FRAME_OVERLAP]; }
 	VkCommandBuffer& currentCmd() { return getCurrentFrame()._commandBuffer; }
 
@@ -101,12 +183,19 @@ private:
 	VkeShader m_fragmentShader;
 	VkeShader m_computeShader;
 
+	VkeShaderWatcher m_shaderWatcher;
+
+	VkeFrameClock m_frameClock;
+
+	VkeGpuProfiler m_gpuProfiler;
+	const char* m_gpuTracePath;
+	const char* m_cpuTracePath;
+	bool m_traceKeyDown{false};
+
 	GPUSceneData m_sceneData;
 
-	VkeDescriptorAllocator m_globalDescriptorAllocator;
 	VkeDescriptor m_drawImageDescriptor;
 	VkeDescriptor m_globalSceneDescriptor;
-	VkeDescriptor m_materialDescriptor;
 
 	VkeSceneManager m_sceneManager;
 	VkeSystemManager m_systemManager;
@@ -116,7 +205,14 @@ private:
 	void startFrame();
 	void endFrame();
 
+	bool isReadbackEnabled() { return m_headless && (m_readbackPath || m_readbackCallback); }
+	void processReadback(FrameData& frame);
+	void addGeometryPass();
+	VkCommandBuffer beginSecondary(const VkCommandBufferInheritanceInfo& inheritance); // from the calling thread's pool
+	void recordDraws(VkCommandBuffer cmd, VkPipeline pipeline, uint32_t sceneDataOffset, uint32_t first, uint32_t last);
+
 	void initPipelines();
+	void reloadShaders();
 };
 
 // TEMP: find a better way to define multiple projects/applications
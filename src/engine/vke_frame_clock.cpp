@@ -0,0 +1,65 @@
+#include "vke_frame_clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace vke;
+
+void VkeFrameClock::init(double fixedStep, uint32_t maxSteps) {
+	m_fixedStep = fixedStep;
+	m_maxSteps = maxSteps;
+}
+
+void VkeFrameClock::tick() {
+	auto now = std::chrono::steady_clock::now();
+
+	// the first frame has nothing to measure, it runs a single fixed step
+	m_deltaTime = m_started ? std::chrono::duration<double>(now - m_lastTick).count() : m_fixedStep;
+	m_lastTick = now;
+
+	if (m_started) {
+		m_frameTimes.push_back(m_deltaTime * 1e3);
+		if (m_frameTimes.size() > FRAME_CLOCK_WINDOW)
+			m_frameTimes.pop_front();
+	}
+
+	m_started = true;
+	m_frame++;
+
+	m_deltaTime = std::min(m_deltaTime, FRAME_CLOCK_MAX_DELTA);
+	m_accumulator += m_deltaTime;
+
+	// after a hitch the simulation falls behind instead of spending every following frame catching up
+	m_accumulator = std::min(m_accumulator, m_fixedStep * m_maxSteps);
+}
+
+bool VkeFrameClock::consumeFixedStep() {
+	if (m_accumulator < m_fixedStep)
+		return false;
+
+	m_accumulator -= m_fixedStep;
+	m_time += m_fixedStep;
+
+	return true;
+}
+
+VkeFrameClock::Stats VkeFrameClock::getStats() {
+	if (m_frameTimes.empty())
+		return {};
+
+	std::vector<double> frameTimes(m_frameTimes.begin(), m_frameTimes.end());
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	double total = 0.0;
+	for (double frameTime : frameTimes)
+		total += frameTime;
+
+	return {
+		.samples = (uint32_t)frameTimes.size(),
+		.avgMs = total / frameTimes.size(),
+		.p95Ms = frameTimes[(size_t)std::ceil(frameTimes.size() * 0.95) - 1],
+		.p99Ms = frameTimes[(size_t)std::ceil(frameTimes.size() * 0.99) - 1],
+		.maxMs = frameTimes.back(),
+	};
+}
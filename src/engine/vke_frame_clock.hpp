@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+namespace vke {
+
+constexpr uint32_t FRAME_CLOCK_WINDOW = 240; // frame times kept for the statistics
+constexpr double FRAME_CLOCK_MAX_DELTA = 0.25; // seconds, longer frames (a breakpoint, a load) count as this much
+
+// measures the main loop and splits the elapsed time into fixed simulation steps, whatever the present rate is;
+// rendering interpolates between the last two fixed states with the alpha left over
+class VkeFrameClock {
+public:
+	struct Stats {
+		uint32_t samples;
+		double avgMs;
+		double p95Ms;
+		double p99Ms;
+		double maxMs;
+	};
+
+	void init(double fixedStep, uint32_t maxSteps);
+
+	void tick(); // once per frame, before the fixed steps are consumed
+	bool consumeFixedStep(); // true while the accumulated time still holds a fixed step
+
+	float getDeltaTime() { return (float)m_deltaTime; } // seconds since the previous tick
+	float getFixedStep() { return (float)m_fixedStep; }
+	float getAlpha() { return (float)(m_accumulator / m_fixedStep); } // [0, 1), progress towards the next fixed step
+	double getTime() { return m_time; } // seconds of simulation, advanced by the fixed steps
+	uint64_t getFrame() { return m_frame; }
+
+	Stats getStats();
+
+private:
+	std::chrono::steady_clock::time_point m_lastTick;
+	bool m_started{false};
+
+	double m_fixedStep;
+	uint32_t m_maxSteps;
+
+	double m_deltaTime{0.0};
+	double m_accumulator{0.0};
+	double m_time{0.0};
+	uint64_t m_frame{0};
+
+	std::deque<double> m_frameTimes; // milliseconds, newest last
+};
+
+} // namespace vke
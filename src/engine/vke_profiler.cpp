@@ -0,0 +1,175 @@
+#include "vke_profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace vke;
+
+struct ProfileZone {
+	const char* name;
+	uint64_t startNs;
+	uint64_t endNs;
+};
+
+// single producer, single consumer: the owning thread moves head, the merge moves tail
+struct ThreadRing {
+	ProfileZone zones[PROFILER_RING_SIZE];
+	std::atomic<uint64_t> head{0};
+	std::atomic<uint64_t> tail{0};
+	std::atomic<uint64_t> dropped{0};
+	uint32_t threadId;
+	std::string name;
+};
+
+struct MergedZone {
+	const char* name;
+	uint32_t threadId;
+	uint64_t startNs;
+	uint64_t endNs;
+};
+
+struct MergedFrame {
+	uint64_t index;
+	std::vector<MergedZone> zones;
+};
+
+// rings stay alive after their thread exits so nothing it recorded is lost
+static std::mutex s_ringMutex;
+static std::vector<std::unique_ptr<ThreadRing>> s_rings;
+static thread_local ThreadRing* t_ring = nullptr;
+
+static std::deque<MergedFrame> s_frames;
+static uint64_t s_frameIndex = 0;
+static uint64_t s_zoneCount = 0;
+
+static ThreadRing* getThreadRing() {
+	if (t_ring)
+		return t_ring;
+
+	std::lock_guard lock(s_ringMutex);
+
+	s_rings.push_back(std::make_unique<ThreadRing>());
+	t_ring = s_rings.back().get();
+	t_ring->threadId = (uint32_t)s_rings.size() - 1;
+	t_ring->name = fmt::format("thread {}", t_ring->threadId);
+
+	return t_ring;
+}
+
+uint64_t VkeProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void VkeProfiler::record(const char* name, uint64_t startNs, uint64_t endNs) {
+	ThreadRing* ring = getThreadRing();
+
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) >= PROFILER_RING_SIZE) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring->zones[head % PROFILER_RING_SIZE] = {name, startNs, endNs};
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void VkeProfiler::setThreadName(const char* name) {
+	ThreadRing* ring = getThreadRing();
+
+	std::lock_guard lock(s_ringMutex);
+	ring->name = name;
+}
+
+void VkeProfiler::endFrame() {
+	MergedFrame frame = {.index = s_frameIndex++};
+
+	{
+		std::lock_guard lock(s_ringMutex);
+
+		for (std::unique_ptr<ThreadRing>& ring : s_rings) {
+			uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+
+			for (; tail < head; tail++) {
+				const ProfileZone& zone = ring->zones[tail % PROFILER_RING_SIZE];
+				frame.zones.push_back({zone.name, ring->threadId, zone.startNs, zone.endNs});
+			}
+
+			ring->tail.store(tail, std::memory_order_release);
+		}
+	}
+
+	// zones are recorded when they end, the trace wants them by start
+	std::sort(frame.zones.begin(), frame.zones.end(),
+			  [](const MergedZone& a, const MergedZone& b) { return a.startNs < b.startNs; });
+
+	s_zoneCount += frame.zones.size();
+	s_frames.push_back(std::move(frame));
+
+	if (s_frames.size() > PROFILER_MAX_FRAMES)
+		s_frames.pop_front();
+}
+
+VkResult VkeProfiler::writeChromeTrace(const char* path) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	uint64_t origin = UINT64_MAX;
+	for (const MergedFrame& frame : s_frames) {
+		if (!frame.zones.empty())
+			origin = std::min(origin, frame.zones.front().startNs);
+	}
+
+	file << "{\"traceEvents\":[";
+
+	bool first = true;
+	auto separator = [&]() {
+		const char* text = first ? "\n" : ",\n";
+		first = false;
+		return text;
+	};
+
+	{
+		std::lock_guard lock(s_ringMutex);
+
+		for (const std::unique_ptr<ThreadRing>& ring : s_rings) {
+			file << fmt::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+								separator(), ring->threadId, ring->name);
+		}
+	}
+
+	for (const MergedFrame& frame : s_frames) {
+		for (const MergedZone& zone : frame.zones) {
+			file << fmt::format("{}{{\"name\":\"{}\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},"
+								"\"args\":{{\"frame\":{}}}}}",
+								separator(), zone.name, zone.threadId, (zone.startNs - origin) / 1e3,
+								(zone.endNs - zone.startNs) / 1e3, frame.index);
+		}
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	file.close();
+
+	return file.fail() ? VK_ERROR_INITIALIZATION_FAILED : VK_SUCCESS;
+}
+
+VkeProfiler::Stats VkeProfiler::getStats() {
+	std::lock_guard lock(s_ringMutex);
+
+	Stats stats = {
+		.frames = (uint32_t)s_frames.size(),
+		.threads = (uint32_t)s_rings.size(),
+		.zones = s_zoneCount,
+	};
+
+	for (const std::unique_ptr<ThreadRing>& ring : s_rings)
+		stats.droppedZones += ring->dropped.load(std::memory_order_relaxed);
+
+	return stats;
+}
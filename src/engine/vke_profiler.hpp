@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../renderer/vke_types.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+// zones compile to nothing unless VKE_PROFILING is defined, see the VKE_ENABLE_PROFILING cmake option
+#ifdef VKE_PROFILING
+#define VKE_PROFILE_CONCAT_INNER(a, b) a##b
+#define VKE_PROFILE_CONCAT(a, b) VKE_PROFILE_CONCAT_INNER(a, b)
+#define VKE_PROFILE_SCOPE(name) vke::VkeProfileScope VKE_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define VKE_PROFILE_THREAD(name) vke::VkeProfiler::setThreadName(name)
+#define VKE_PROFILE_FRAME() vke::VkeProfiler::endFrame()
+#else
+#define VKE_PROFILE_SCOPE(name)
+#define VKE_PROFILE_THREAD(name)
+#define VKE_PROFILE_FRAME()
+#endif
+
+namespace vke {
+
+constexpr uint32_t PROFILER_RING_SIZE = 4096; // zones a thread can record between two merges, later ones are dropped
+constexpr uint32_t PROFILER_MAX_FRAMES = 600; // merged frames kept for the trace
+
+// every thread records its zones into a ring of its own without locking, the main thread merges them once per frame;
+// names have to outlive the profiler, string literals are expected
+class VkeProfiler {
+public:
+	struct Stats {
+		uint32_t frames; // kept for the trace
+		uint32_t threads;
+		uint64_t zones;
+		uint64_t droppedZones; // rings that filled up before a merge
+	};
+
+	static uint64_t now(); // nanoseconds, steady clock
+	static void record(const char* name, uint64_t startNs, uint64_t endNs);
+	static void setThreadName(const char* name);
+
+	// both from the main thread only
+	static void endFrame();
+	static VkResult writeChromeTrace(const char* path);
+
+	static Stats getStats();
+};
+
+class VkeProfileScope {
+public:
+	explicit VkeProfileScope(const char* name) : m_name(name), m_start(VkeProfiler::now()) {}
+	~VkeProfileScope() { VkeProfiler::record(m_name, m_start, VkeProfiler::now()); }
+
+	VkeProfileScope(const VkeProfileScope&) = delete;
+	VkeProfileScope& operator=(const VkeProfileScope&) = delete;
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+};
+
+} // namespace vke
@@ -1,9 +1,32 @@
 #include "demo_application.hpp"
 
+#include <cstdlib>
+#include <string_view>
+
 int main(int argc, char* argv[]) {
 	DemoApplication app;
 
-	app.init();
+	// --headless [--frames n] [--readback path] [--dump-graph] [--measure-warmup], e.g. for lavapipe on machines without a GPU
+	GameEngineSettings settings = VkEngine::defaultSettings;
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+
+		if (arg == "--headless") {
+			// nothing edits shaders during a scripted run
+			settings.headless = true;
+			settings.shaderSourceDir = nullptr;
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+			settings.frameLimit = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--readback" && i + 1 < argc)
+			settings.readbackPath = argv[++i];
+		else if (arg == "--dump-graph")
+			settings.dumpFrameGraph = true;
+		else if (arg == "--measure-warmup")
+			settings.measurePipelineWarmup = true;
+	}
+
+	app.init(settings);
 
 	app.run();
 
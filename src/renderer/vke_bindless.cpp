@@ -0,0 +1,120 @@
+#include "vke_bindless.hpp"
+
+using namespace vke;
+
+VkResult VkeBindlessHeap::init(VkDevice device) {
+	m_device = device;
+
+	// every binding is partially bound, so unused handles never have to hold a valid descriptor
+	VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+	m_descriptor.addBinding(SAMPLED_IMAGE_BINDING, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_SAMPLED_IMAGES, flags);
+	m_descriptor.addBinding(SAMPLER_BINDING, VK_DESCRIPTOR_TYPE_SAMPLER, MAX_SAMPLERS, flags);
+	m_descriptor.addBinding(STORAGE_BUFFER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_STORAGE_BUFFERS, flags);
+	VK_RETURN(m_descriptor.initLayout(device, VK_SHADER_STAGE_ALL));
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_SAMPLED_IMAGES},
+		{VK_DESCRIPTOR_TYPE_SAMPLER, MAX_SAMPLERS},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_STORAGE_BUFFERS},
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = 3,
+		.pPoolSizes = poolSizes,
+	};
+
+	VK_RETURN(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_pool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = m_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &m_descriptor.m_descriptorSetLayout,
+	};
+
+	VK_RETURN(vkAllocateDescriptorSets(device, &allocInfo, &m_descriptor.m_descriptorSet));
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeBindlessHeap::registerImage(VkImageView imageView, uint32_t* handle, VkImageLayout layout) {
+	if (!m_images.acquire(handle))
+		return VK_ERROR_TOO_MANY_OBJECTS;
+
+	VkDescriptorImageInfo info = {
+		.imageView = imageView,
+		.imageLayout = layout,
+	};
+
+	write(SAMPLED_IMAGE_BINDING, *handle, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &info, nullptr);
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeBindlessHeap::registerSampler(VkSampler sampler, uint32_t* handle) {
+	if (!m_samplers.acquire(handle))
+		return VK_ERROR_TOO_MANY_OBJECTS;
+
+	VkDescriptorImageInfo info = {
+		.sampler = sampler,
+	};
+
+	write(SAMPLER_BINDING, *handle, VK_DESCRIPTOR_TYPE_SAMPLER, &info, nullptr);
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeBindlessHeap::registerStorageBuffer(VkBuffer buffer, VkDeviceSize size, uint32_t* handle, VkDeviceSize offset) {
+	if (!m_storageBuffers.acquire(handle))
+		return VK_ERROR_TOO_MANY_OBJECTS;
+
+	VkDescriptorBufferInfo info = {
+		.buffer = buffer,
+		.offset = offset,
+		.range = size,
+	};
+
+	write(STORAGE_BUFFER_BINDING, *handle, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &info);
+
+	return VK_SUCCESS;
+}
+
+void VkeBindlessHeap::write(uint32_t binding, uint32_t handle, VkDescriptorType type, const VkDescriptorImageInfo* imageInfo,
+							const VkDescriptorBufferInfo* bufferInfo) {
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = m_descriptor.m_descriptorSet,
+		.dstBinding = binding,
+		.dstArrayElement = handle,
+		.descriptorCount = 1,
+		.descriptorType = type,
+		.pImageInfo = imageInfo,
+		.pBufferInfo = bufferInfo,
+	};
+
+	// update after bind allows writing while the set is bound by frames in flight
+	vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+bool VkeBindlessHeap::HandleTable::acquire(uint32_t* handle) {
+	if (!freeHandles.empty()) {
+		*handle = freeHandles.back();
+		freeHandles.pop_back();
+		return true;
+	}
+
+	if (next == capacity)
+		return false;
+
+	*handle = next++;
+	return true;
+}
+
+void VkeBindlessHeap::HandleTable::release(uint32_t handle) {
+	if (handle != INVALID_HANDLE)
+		freeHandles.push_back(handle);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vke_descriptors.hpp"
+#include "vke_types.hpp"
+
+namespace vke {
+
+// global descriptor table indexed from shaders through push constants, bound once per pipeline
+class VkeBindlessHeap {
+	friend class VkeDevice;
+
+public:
+	static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+	static constexpr uint32_t SAMPLED_IMAGE_BINDING = 0;
+	static constexpr uint32_t SAMPLER_BINDING = 1;
+	static constexpr uint32_t STORAGE_BUFFER_BINDING = 2;
+
+	static constexpr uint32_t MAX_SAMPLED_IMAGES = 4096;
+	static constexpr uint32_t MAX_SAMPLERS = 64;
+	static constexpr uint32_t MAX_STORAGE_BUFFERS = 1024;
+
+	VkResult registerImage(VkImageView imageView, uint32_t* handle,
+						   VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	VkResult registerSampler(VkSampler sampler, uint32_t* handle);
+	VkResult registerStorageBuffer(VkBuffer buffer, VkDeviceSize size, uint32_t* handle, VkDeviceSize offset = 0);
+
+	// handles are reused right away, only release what the GPU no longer reads
+	void releaseImage(uint32_t handle) { m_images.release(handle); }
+	void releaseSampler(uint32_t handle) { m_samplers.release(handle); }
+	void releaseStorageBuffer(uint32_t handle) { m_storageBuffers.release(handle); }
+
+	VkeDescriptor& getDescriptor() { return m_descriptor; }
+
+private:
+	struct HandleTable {
+		std::vector<uint32_t> freeHandles;
+		uint32_t next{0};
+		uint32_t capacity;
+
+		bool acquire(uint32_t* handle);
+		void release(uint32_t handle);
+	};
+
+	VkDevice m_device;
+	VkDescriptorPool m_pool;
+	VkeDescriptor m_descriptor;
+
+	HandleTable m_images{.capacity = MAX_SAMPLED_IMAGES};
+	HandleTable m_samplers{.capacity = MAX_SAMPLERS};
+	HandleTable m_storageBuffers{.capacity = MAX_STORAGE_BUFFERS};
+
+	VkResult init(VkDevice device);
+	void write(uint32_t binding, uint32_t handle, VkDescriptorType type, const VkDescriptorImageInfo* imageInfo,
+			   const VkDescriptorBufferInfo* bufferInfo);
+};
+
+} // namespace vke
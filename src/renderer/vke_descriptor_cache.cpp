@@ -0,0 +1,118 @@
+#include "vke_descriptor_cache.hpp"
+#include "vke_utils.hpp"
+
+using namespace vke;
+
+VkResult VkeDescriptorCache::init(VkDevice device) {
+	std::vector<VkeDescriptorAllocator::PoolSizeRatio> sizes = {
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2},
+		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1},
+		{VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+	};
+
+	return m_allocator.initPool(device, 128, sizes);
+}
+
+VkResult VkeDescriptorCache::getDescriptorSet(VkDevice device, VkeDescriptor* descriptor) {
+	std::vector<WriteKey> writes;
+	writes.reserve(descriptor->m_writes.size());
+
+	for (const VkWriteDescriptorSet& write : descriptor->m_writes) {
+		WriteKey key{
+			.binding = write.dstBinding,
+			.arrayElement = write.dstArrayElement,
+			.type = (uint32_t)write.descriptorType,
+		};
+
+		if (write.pImageInfo) {
+			key.first = (uint64_t)write.pImageInfo->sampler;
+			key.second = (uint64_t)write.pImageInfo->imageView;
+			key.layout = (uint32_t)write.pImageInfo->imageLayout;
+		} else if (write.pBufferInfo) {
+			key.first = (uint64_t)write.pBufferInfo->buffer;
+			key.second = write.pBufferInfo->offset;
+			key.third = write.pBufferInfo->range;
+		}
+
+		writes.push_back(key);
+	}
+
+	VkDescriptorSetLayout layout = descriptor->m_descriptorSetLayout;
+	uint64_t hash = vkutil::hashValue(layout);
+	hash = vkutil::hashBytes(writes.data(), writes.size() * sizeof(WriteKey), hash);
+
+	auto [begin, end] = m_lookup.equal_range(hash);
+	for (auto it = begin; it != end; it++) {
+		Entry& entry = *it->second;
+
+		if (entry.layout != layout || entry.writes != writes)
+			continue;
+
+		entry.lastUsedFrame = m_frame;
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+		descriptor->m_descriptorSet = entry.set;
+		descriptor->clearWrites();
+
+		m_stats.hits++;
+		m_stats.hitsFrame++;
+
+		return VK_SUCCESS;
+	}
+
+	VkDescriptorPool pool;
+	VK_RETURN(m_allocator.allocate(device, descriptor, &pool));
+
+	m_entries.push_front(Entry{
+		.hash = hash,
+		.layout = layout,
+		.writes = std::move(writes),
+		.set = descriptor->m_descriptorSet,
+		.pool = pool,
+		.lastUsedFrame = m_frame,
+	});
+	m_lookup.emplace(hash, m_entries.begin());
+
+	m_stats.misses++;
+	m_stats.missesFrame++;
+
+	evict(device);
+
+	m_stats.cachedSets = (uint32_t)m_entries.size();
+
+	return VK_SUCCESS;
+}
+
+void VkeDescriptorCache::newFrame() {
+	m_frame++;
+
+	m_stats.hitsFrame = 0;
+	m_stats.missesFrame = 0;
+}
+
+void VkeDescriptorCache::evict(VkDevice device) {
+	while (m_entries.size() > MAX_CACHED_SETS) {
+		Entry& entry = m_entries.back();
+
+		// every other set was used even more recently
+		if (m_frame - entry.lastUsedFrame < FRAME_LIFETIME)
+			break;
+
+		auto [begin, end] = m_lookup.equal_range(entry.hash);
+		for (auto it = begin; it != end; it++) {
+			if (&*it->second == &entry) {
+				m_lookup.erase(it);
+				break;
+			}
+		}
+
+		vkFreeDescriptorSets(device, entry.pool, 1, &entry.set);
+		m_entries.pop_back();
+
+		m_stats.evictions++;
+	}
+}
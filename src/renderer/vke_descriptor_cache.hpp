@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vke_descriptors.hpp"
+#include "vke_types.hpp"
+
+#include <list>
+#include <unordered_map>
+
+namespace vke {
+
+// reuses descriptor sets whose layout and writes match a previous request, least recently used sets are evicted first
+class VkeDescriptorCache {
+	friend class VkeDevice;
+
+public:
+	struct Stats {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint32_t hitsFrame;
+		uint32_t missesFrame;
+		uint32_t cachedSets;
+	};
+
+	static constexpr uint32_t MAX_CACHED_SETS = 1024;
+	static constexpr uint64_t FRAME_LIFETIME = 3; // frames a set stays unused before eviction, more than the frames in flight
+
+	VkResult getDescriptorSet(VkDevice device, VkeDescriptor* descriptor);
+	void newFrame();
+
+	Stats getStats() { return m_stats; }
+	float getHitRate() {
+		uint64_t total = m_stats.hits + m_stats.misses;
+		return total ? float(m_stats.hits) / float(total) : 0.f;
+	}
+
+private:
+	// image writes store sampler, view and layout, buffer writes store buffer, offset and range
+	struct WriteKey {
+		uint64_t first;
+		uint64_t second;
+		uint64_t third;
+		uint32_t binding;
+		uint32_t arrayElement;
+		uint32_t type;
+		uint32_t layout;
+
+		bool operator==(const WriteKey& other) const = default;
+	};
+
+	struct Entry {
+		uint64_t hash;
+		VkDescriptorSetLayout layout;
+		std::vector<WriteKey> writes;
+
+		VkDescriptorSet set;
+		VkDescriptorPool pool;
+		uint64_t lastUsedFrame;
+	};
+
+	VkeDescriptorAllocator m_allocator;
+
+	std::list<Entry> m_entries; // most recently used first
+	std::unordered_multimap<uint64_t, std::list<Entry>::iterator> m_lookup;
+
+	uint64_t m_frame{0};
+	Stats m_stats{};
+
+	VkResult init(VkDevice device);
+	void evict(VkDevice device);
+};
+
+} // namespace vke
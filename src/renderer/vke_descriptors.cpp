@@ -1,5 +1,7 @@
 #include "vke_descriptors.hpp"
 
+#include <algorithm>
+
 using namespace vke;
 
 VkResult VkeDescriptor::initLayout(VkDevice device, VkShaderStageFlags shaderStages) {
@@ -7,10 +9,22 @@ VkResult VkeDescriptor::initLayout(VkDevice device, VkShaderStageFlags shaderSta
 		binding.stageFlags |= shaderStages;
 	}
 
+	VkDescriptorSetLayoutCreateFlags flags = 0;
+	for (VkDescriptorBindingFlags bindingFlags : m_bindingFlags) {
+		if (bindingFlags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+			flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = (uint32_t)m_bindingFlags.size(),
+		.pBindingFlags = m_bindingFlags.data(),
+	};
+
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-		.pNext = nullptr,
-		.flags = 0,
+		.pNext = &bindingFlagsInfo,
+		.flags = flags,
 		.bindingCount = (uint32_t)m_bindings.size(),
 		.pBindings = m_bindings.data(),
 	};
@@ -19,8 +33,35 @@ VkResult VkeDescriptor::initLayout(VkDevice device, VkShaderStageFlags shaderSta
 	return VK_SUCCESS;
 }
 
-void VkeDescriptor::addBinding(uint32_t binding, VkDescriptorType type) {
-	m_bindings.push_back({.binding = binding, .descriptorType = type, .descriptorCount = 1});
+void VkeDescriptor::addBinding(uint32_t binding, VkDescriptorType type, uint32_t count, VkDescriptorBindingFlags flags) {
+	m_bindings.push_back({.binding = binding, .descriptorType = type, .descriptorCount = count});
+	m_bindingFlags.push_back(flags);
+}
+
+void VkeDescriptor::addBindings(std::span<const VkeShaderReflection::Binding> bindings, bool dynamicBuffers) {
+	for (const VkeShaderReflection::Binding& binding : bindings) {
+		VkDescriptorType type = binding.type;
+
+		if (dynamicBuffers && type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		else if (dynamicBuffers && type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+			type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+		// runtime arrays belong in the bindless heap, a plain set gets a single descriptor
+		m_bindings.push_back({
+			.binding = binding.binding,
+			.descriptorType = type,
+			.descriptorCount = binding.count ? binding.count : 1,
+			.stageFlags = binding.stages,
+		});
+		m_bindingFlags.push_back(0);
+	}
+}
+
+void VkeDescriptor::clearWrites() {
+	m_writes.clear();
+	m_imageInfos.clear();
+	m_bufferInfos.clear();
 }
 
 void VkeDescriptor::writeImage(uint32_t binding, VkImageView imageView, VkSampler sampler, VkImageLayout layout) {
@@ -61,38 +102,106 @@ void VkeDescriptor::writeBuffer(uint32_t binding, VkBuffer buffer, size_t size,
 }
 
 VkResult VkeDescriptorAllocator::initPool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios) {
+	m_ratios.assign(poolRatios.begin(), poolRatios.end());
+
+	VkDescriptorPool pool;
+	VK_RETURN(createPool(device, maxSets, &pool));
+
+	m_readyPools.push_back(pool);
+
+	// next pools will be bigger
+	m_setsPerPool = std::min(uint32_t(maxSets * 1.5f), MAX_SETS_PER_POOL);
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDescriptorAllocator::createPool(VkDevice device, uint32_t setCount, VkDescriptorPool* pool) {
 	std::vector<VkDescriptorPoolSize> poolSizes;
 
-	for (PoolSizeRatio ratio : poolRatios) {
+	for (PoolSizeRatio ratio : m_ratios) {
 		poolSizes.push_back(VkDescriptorPoolSize{
 			.type = ratio.type,
-			.descriptorCount = uint32_t(ratio.ratio * maxSets),
+			.descriptorCount = uint32_t(ratio.ratio * setCount),
 		});
 	}
 
 	VkDescriptorPoolCreateInfo poolInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 		.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-		.maxSets = maxSets,
+		.maxSets = setCount,
 		.poolSizeCount = (uint32_t)poolSizes.size(),
 		.pPoolSizes = poolSizes.data(),
 	};
 
-	return vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_pool);
+	VK_RETURN(vkCreateDescriptorPool(device, &poolInfo, nullptr, pool));
+
+	m_stats.poolsCreated++;
+
+	return VK_SUCCESS;
 }
 
-VkResult VkeDescriptorAllocator::resetDescriptorPool(VkDevice device) { return vkResetDescriptorPool(device, m_pool, 0); }
+VkResult VkeDescriptorAllocator::getPool(VkDevice device, VkDescriptorPool* pool) {
+	if (!m_readyPools.empty()) {
+		*pool = m_readyPools.back();
+		return VK_SUCCESS;
+	}
+
+	VK_RETURN(createPool(device, m_setsPerPool, pool));
+	m_readyPools.push_back(*pool);
+
+	m_setsPerPool = std::min(uint32_t(m_setsPerPool * 1.5f), MAX_SETS_PER_POOL);
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDescriptorAllocator::resetDescriptorPool(VkDevice device) {
+	for (VkDescriptorPool pool : m_readyPools)
+		VK_RETURN(vkResetDescriptorPool(device, pool, 0));
+
+	// full pools are recycled instead of destroyed
+	for (VkDescriptorPool pool : m_fullPools) {
+		VK_RETURN(vkResetDescriptorPool(device, pool, 0));
+		m_readyPools.push_back(pool);
+	}
+
+	m_fullPools.clear();
+
+	m_stats.setsAllocated = 0;
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDescriptorAllocator::allocate(VkDevice device, VkeDescriptor* descriptorSet, VkDescriptorPool* usedPool) {
+	VkDescriptorPool pool;
+	VK_RETURN(getPool(device, &pool));
 
-VkResult VkeDescriptorAllocator::allocate(VkDevice device, VkeDescriptor* descriptorSet) {
 	VkDescriptorSetAllocateInfo allocInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 		.pNext = nullptr,
-		.descriptorPool = m_pool,
+		.descriptorPool = pool,
 		.descriptorSetCount = 1,
 		.pSetLayouts = &descriptorSet->m_descriptorSetLayout,
 	};
 
-	VK_RETURN(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet->m_descriptorSet));
+	VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet->m_descriptorSet);
+
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		m_readyPools.pop_back();
+		m_fullPools.push_back(pool);
+
+		VK_RETURN(getPool(device, &pool));
+
+		allocInfo.descriptorPool = pool;
+		result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet->m_descriptorSet);
+	}
+
+	VK_RETURN(result);
+
+	m_stats.setsAllocated++;
+	m_stats.setsHighWaterMark = std::max(m_stats.setsHighWaterMark, m_stats.setsAllocated);
+
+	if (usedPool)
+		*usedPool = pool;
 
 	for (VkWriteDescriptorSet& write : descriptorSet->m_writes) {
 		write.dstSet = descriptorSet->m_descriptorSet;
@@ -100,11 +209,18 @@ VkResult VkeDescriptorAllocator::allocate(VkDevice device, VkeDescriptor* descri
 
 	vkUpdateDescriptorSets(device, (uint32_t)descriptorSet->m_writes.size(), descriptorSet->m_writes.data(), 0, nullptr);
 
-	descriptorSet->m_writes.clear();
-	descriptorSet->m_imageInfos.clear();
-	descriptorSet->m_bufferInfos.clear();
+	descriptorSet->clearWrites();
 
 	return VK_SUCCESS;
 }
 
-void VkeDescriptorAllocator::destroyPoll(VkDevice device) { vkDestroyDescriptorPool(device, m_pool, nullptr); }
+void VkeDescriptorAllocator::destroyPools(VkDevice device) {
+	for (VkDescriptorPool pool : m_readyPools)
+		vkDestroyDescriptorPool(device, pool, nullptr);
+
+	for (VkDescriptorPool pool : m_fullPools)
+		vkDestroyDescriptorPool(device, pool, nullptr);
+
+	m_readyPools.clear();
+	m_fullPools.clear();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "vke_shader_reflection.hpp"
 #include "vke_types.hpp"
 
 namespace vke {
@@ -8,35 +9,61 @@ class VkeDescriptor {
 	friend class VkePipeline;
 	friend struct VkeDescriptorAllocator;
 	friend class VkeDevice;
+	friend class VkeBindlessHeap;
+	friend class VkeDescriptorCache;
 
 public:
-	void addBinding(uint32_t binding, VkDescriptorType type);
+	void addBinding(uint32_t binding, VkDescriptorType type, uint32_t count = 1, VkDescriptorBindingFlags flags = 0);
+	void addBindings(std::span<const VkeShaderReflection::Binding> bindings, bool dynamicBuffers = false);
 	void writeImage(uint32_t binding, VkImageView imageView, VkSampler sampler, VkImageLayout layout);
 	void writeBuffer(uint32_t binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type);
 
 private:
 	VkResult initLayout(VkDevice device, VkShaderStageFlags shaderStages);
+	void clearWrites();
 
 	VkDescriptorSet m_descriptorSet;
 	VkDescriptorSetLayout m_descriptorSetLayout;
 
 	std::vector<VkDescriptorSetLayoutBinding> m_bindings;
-	std::vector<VkDescriptorImageInfo> m_imageInfos;
-	std::vector<VkDescriptorBufferInfo> m_bufferInfos;
+	std::vector<VkDescriptorBindingFlags> m_bindingFlags;
+	std::deque<VkDescriptorImageInfo> m_imageInfos; // deques, the writes point into them
+	std::deque<VkDescriptorBufferInfo> m_bufferInfos;
 	std::vector<VkWriteDescriptorSet> m_writes;
 };
 
+// keeps a list of ready and full pools, growing with bigger pools when the ready ones run out
 struct VkeDescriptorAllocator {
 	struct PoolSizeRatio {
 		VkDescriptorType type;
 		float ratio;
 	};
 
-	VkDescriptorPool m_pool;
+	struct Stats {
+		uint32_t poolsCreated;
+		uint32_t setsAllocated; // since the last reset
+		uint32_t setsHighWaterMark;
+	};
+
+	static constexpr uint32_t MAX_SETS_PER_POOL = 4092;
+
 	VkResult initPool(VkDevice device, uint32_t maxSets, std::span<PoolSizeRatio> poolRatios);
 	VkResult resetDescriptorPool(VkDevice device);
-	VkResult allocate(VkDevice device, VkeDescriptor* descriptorSet);
-	void destroyPoll(VkDevice device);
+	VkResult allocate(VkDevice device, VkeDescriptor* descriptorSet, VkDescriptorPool* usedPool = nullptr);
+	void destroyPools(VkDevice device);
+
+	Stats getStats() { return m_stats; }
+
+private:
+	std::vector<PoolSizeRatio> m_ratios;
+	std::vector<VkDescriptorPool> m_fullPools;
+	std::vector<VkDescriptorPool> m_readyPools;
+	uint32_t m_setsPerPool;
+
+	Stats m_stats{};
+
+	VkResult getPool(VkDevice device, VkDescriptorPool* pool);
+	VkResult createPool(VkDevice device, uint32_t setCount, VkDescriptorPool* pool);
 };
 
 } // namespace vke
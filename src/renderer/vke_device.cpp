@@ -2,6 +2,11 @@
 #include "vke_images.hpp"
 #include "vke_initializers.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
@@ -9,10 +14,17 @@ using namespace vke;
 
 constexpr bool useValidationLayers = true; // TODO: handle debug mode in a better way
 
-VkResult VkeDevice::init(VkeWindow* window) {
+VkResult VkeDevice::init(VkeWindow* window, VkeJobSystem* jobSystem, const char* pipelineCachePath,
+						 const char* shaderArchivePath) {
+	m_jobSystem = jobSystem;
+
 	vkb::InstanceBuilder builder;
 
+	// without a window no surface extensions are enabled, lavapipe and other devices without presentation qualify
+	bool headless = window == nullptr;
+
 	auto instRet = builder.set_app_name("Vulkan Engine")
+					   .set_headless(headless)
 					   .request_validation_layers(useValidationLayers)
 					   .use_default_debug_messenger()
 					   .require_api_version(1, 3, 0)
@@ -24,7 +36,8 @@ VkResult VkeDevice::init(VkeWindow* window) {
 	m_debugMessenger = vkbInst.debug_messenger;
 
 	// physical and logical devices
-	VK_RETURN(glfwCreateWindowSurface(m_vkInstance, window->getWindow(), nullptr, &m_surface));
+	if (!headless)
+		VK_RETURN(glfwCreateWindowSurface(m_vkInstance, window->getWindow(), nullptr, &m_surface));
 
 	VkPhysicalDeviceVulkan13Features features{};
 	features.dynamicRendering = true;
@@ -33,24 +46,49 @@ VkResult VkeDevice::init(VkeWindow* window) {
 	VkPhysicalDeviceVulkan12Features features12{};
 	features12.bufferDeviceAddress = true;
 	features12.descriptorIndexing = true;
+	features12.timelineSemaphore = true;
+	features12.runtimeDescriptorArray = true;
+	features12.descriptorBindingPartiallyBound = true;
+	features12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+	features12.shaderSampledImageArrayNonUniformIndexing = true;
 
 	vkb::PhysicalDeviceSelector selector{vkbInst};
-	vkb::PhysicalDevice phyisicalDevice = selector.set_minimum_version(1, 3)
-											  .set_required_features_13(features)
-											  .set_required_features_12(features12)
-											  .set_surface(m_surface)
-											  .select()
-											  .value();
+	selector.set_minimum_version(1, 3).set_required_features_13(features).set_required_features_12(features12);
+	if (!headless)
+		selector.set_surface(m_surface);
+
+	auto physicalDeviceRet = selector.select();
+	if (!physicalDeviceRet) {
+		fmt::println("No suitable device: {}", physicalDeviceRet.error().message());
+		return VK_ERROR_INITIALIZATION_FAILED;
+	}
+
+	vkb::PhysicalDevice phyisicalDevice = physicalDeviceRet.value();
+	fmt::println("Selected device: {}", phyisicalDevice.name);
 
 	vkb::DeviceBuilder deviceBuilder{phyisicalDevice};
 	vkb::Device vkbDevice = deviceBuilder.build().value();
 
 	m_chosenGPU = vkbDevice.physical_device;
+	vkGetPhysicalDeviceProperties(m_chosenGPU, &m_properties);
 	m_device = vkbDevice.device;
 
 	m_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	m_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// prefer a transfer-only family, then any family other than the graphics one
+	if (auto dedicated = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer); dedicated.has_value()) {
+		m_transferQueue = dedicated.value();
+		m_transferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+	} else if (auto separate = vkbDevice.get_queue(vkb::QueueType::transfer); separate.has_value()) {
+		m_transferQueue = separate.value();
+		m_transferQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer).value();
+	} else {
+		m_transferQueue = m_graphicsQueue;
+		m_transferQueueFamily = m_graphicsQueueFamily;
+	}
+
 	VmaAllocatorCreateInfo allocatorInfo = {
 		.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
 		.physicalDevice = m_chosenGPU,
@@ -63,74 +101,404 @@ VkResult VkeDevice::init(VkeWindow* window) {
 	VK_RETURN(createCommandPool(&m_immData._commandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT));
 	VK_RETURN(allocateCommandBuffer(&m_immData._commandBuffer, m_immData._commandPool));
 	VK_RETURN(createFence(&m_immData._fence, VK_FENCE_CREATE_SIGNALED_BIT));
+	VK_RETURN(createTimelineSemaphore(&m_uploadTimeline));
 
-	m_deletionQueue.push_function([this] { vmaDestroyAllocator(m_allocator); });
+	VK_RETURN(createBuffer(GEOMETRY_ARENA_INDICES * sizeof(uint32_t),
+						   VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY,
+						   &m_geometryArena._indexBuffer));
+
+	VK_RETURN(createBuffer(GEOMETRY_ARENA_VERTICES * sizeof(Vertex),
+						   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+							   VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+						   VMA_MEMORY_USAGE_GPU_ONLY, &m_geometryArena._vertexBuffer));
+
+	VkBufferDeviceAddressInfo deviceAdressInfo{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+		.buffer = m_geometryArena._vertexBuffer.buffer,
+	};
+
+	m_geometryArena._vertexBufferAddress = vkGetBufferDeviceAddress(m_device, &deviceAdressInfo);
+	m_geometryArena._vertexRanges.init(GEOMETRY_ARENA_VERTICES);
+	m_geometryArena._indexRanges.init(GEOMETRY_ARENA_INDICES);
+
+	VK_RETURN(createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &m_stagingBuffer));
+	m_stagingRing.init(&m_stagingBuffer);
+
+	VK_RETURN(m_bindlessHeap.init(m_device));
+	m_deletionQueue.pushDescriptorSetLayout(m_bindlessHeap.m_descriptor.m_descriptorSetLayout);
+	m_deletionQueue.pushDescriptorPool(m_bindlessHeap.m_pool);
+
+	VK_RETURN(m_pipelineCache.init(m_device, m_properties, pipelineCachePath));
+
+	if (m_shaderArchive.open(shaderArchivePath) != VK_SUCCESS)
+		fmt::println("No valid shader archive at {}, shaders are loaded from their own files", shaderArchivePath);
+
+	VK_RETURN(m_descriptorCache.init(m_device));
+	m_descriptorAllocators.push_back(&m_descriptorCache.m_allocator);
 
 	return VK_SUCCESS;
 }
 
+void VkeDevice::newFrame() {
+	uint64_t completed;
+	VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_uploadTimeline, &completed));
+
+	m_stagingRing.retire(completed);
+	m_stagingRing.newFrame();
+
+	m_descriptorCache.newFrame();
+}
+
+DeviceMemoryStats VkeDevice::getMemoryStats() {
+	VmaTotalStatistics stats;
+	vmaCalculateStatistics(m_allocator, &stats);
+
+	return {
+		.allocations = stats.total.statistics.allocationCount,
+		.allocationBytes = stats.total.statistics.allocationBytes,
+		.blocks = stats.total.statistics.blockCount,
+		.blockBytes = stats.total.statistics.blockBytes,
+	};
+}
+
 VkResult VkeDevice::createCommandPool(VkCommandPool* pool, VkCommandPoolCreateFlags flags) {
-	auto commandPoolCreateInfo = vkinit::commandPoolCreateInfo(m_graphicsQueueFamily, flags);
+	return createCommandPool(pool, flags, m_graphicsQueueFamily);
+}
 
-	m_deletionQueue.push_function([this, pool] { vkDestroyCommandPool(m_device, *pool, nullptr); });
+VkResult VkeDevice::createCommandPool(VkCommandPool* pool, VkCommandPoolCreateFlags flags, uint32_t queueFamily) {
+	auto commandPoolCreateInfo = vkinit::commandPoolCreateInfo(queueFamily, flags);
 
-	return vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, pool);
+	VK_RETURN(vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, pool));
+	m_deletionQueue.pushCommandPool(*pool);
+
+	return VK_SUCCESS;
 }
 
-VkResult VkeDevice::allocateCommandBuffer(VkCommandBuffer* buffer, VkCommandPool pool) {
-	auto cmdAllocInfo = vkinit::commandBufferAllocateInfo(pool);
+VkResult VkeDevice::allocateCommandBuffer(VkCommandBuffer* buffer, VkCommandPool pool, VkCommandBufferLevel level) {
+	auto cmdAllocInfo = vkinit::commandBufferAllocateInfo(pool, 1, level);
 	return vkAllocateCommandBuffers(m_device, &cmdAllocInfo, buffer);
 }
 
 VkResult VkeDevice::createSemaphore(VkSemaphore* semaphore, VkSemaphoreCreateFlags flags) {
 	auto semaphoreCreateInfo = vkinit::semaphoreCreateInfo(flags);
 
-	m_deletionQueue.push_function([this, semaphore] { vkDestroySemaphore(m_device, *semaphore, nullptr); });
+	VK_RETURN(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, semaphore));
+	m_deletionQueue.pushSemaphore(*semaphore);
 
-	return vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, semaphore);
+	return VK_SUCCESS;
+}
+
+VkResult VkeDevice::createTimelineSemaphore(VkSemaphore* semaphore, uint64_t initialValue) {
+	VkSemaphoreTypeCreateInfo typeInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = initialValue,
+	};
+
+	auto semaphoreCreateInfo = vkinit::semaphoreCreateInfo();
+	semaphoreCreateInfo.pNext = &typeInfo;
+
+	VK_RETURN(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, semaphore));
+	m_deletionQueue.pushSemaphore(*semaphore);
+
+	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::createFence(VkFence* fence, VkFenceCreateFlags flags) {
 	auto fenceCreateInfo = vkinit::fenceCreateInfo(flags);
 
-	m_deletionQueue.push_function([this, fence] { vkDestroyFence(m_device, *fence, nullptr); });
+	VK_RETURN(vkCreateFence(m_device, &fenceCreateInfo, nullptr, fence));
+	m_deletionQueue.pushFence(*fence);
 
-	return vkCreateFence(m_device, &fenceCreateInfo, nullptr, fence);
+	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::createShader(VkeShader& shader, const char* path) {
-	std::vector<uint32_t> buffer;
-	VK_RETURN(shader.loadShaderModule(path, buffer));
+	// packed shaders are used in place, loose files are only read when missing from the archive
+	shader.m_path = path;
 
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.pNext = nullptr;
-	createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-	createInfo.pCode = buffer.data();
+	std::string name = std::filesystem::path(path).filename().string();
+	if (const ShaderArchiveEntry* entry = m_shaderArchive.find(name))
+		return m_shaderArchive.getShader(*entry, &shader);
 
-	VK_RETURN(vkCreateShaderModule(m_device, &createInfo, nullptr, &shader.m_shaderModule));
+	VK_RETURN(shader.loadShaderModule(path));
 
-	fmt::println("Shader module created: {}", path);
+	fmt::println("Shader loaded: {}", path);
 
 	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::destroyShader(VkeShader& shader) {
 	vkDestroyShaderModule(m_device, shader.m_shaderModule, nullptr);
+	shader.m_shaderModule = VK_NULL_HANDLE;
 	return VK_SUCCESS;
 }
 
-VkResult VkeDevice::createPipelineLayout(VkePipeline& pipeline, VkPipelineLayoutCreateInfo& layoutInfo) {
-	VK_RETURN(vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &pipeline.m_pipelineLayout));
+VkResult VkeDevice::reloadShader(VkeShader& shader) {
+	// loaded aside first, a broken file leaves the shader as it was
+	VkeShader reloaded;
+	reloaded.m_path = shader.m_path;
+	VK_RETURN(reloaded.loadShaderModule(shader.m_path.c_str()));
 
-	m_deletionQueue.push_function([this, &pipeline] { vkDestroyPipelineLayout(m_device, pipeline.m_pipelineLayout, nullptr); });
+	// modules are only used while compiling, and nothing compiles from the shader while no reload is pending
+	VK_RETURN(destroyShader(shader));
+	shader = std::move(reloaded);
+
+	fmt::println("Shader reloaded: {}", shader.m_path);
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDevice::createShaderModule(VkeShader& shader) {
+	if (shader.m_shaderModule)
+		return VK_SUCCESS;
+
+	std::span<const uint32_t> code = shader.getCode();
+
+	// archived code is only checked here, so the pages of shaders that are never used are never read
+	if (!shader.m_verified && vkutil::hashBytes(code.data(), code.size_bytes()) != shader.m_hash) {
+		fmt::println("Shader {:016x} does not match its checksum", shader.m_hash);
+		return VK_ERROR_INITIALIZATION_FAILED;
+	}
+	shader.m_verified = true;
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.pNext = nullptr;
+	createInfo.codeSize = code.size_bytes();
+	createInfo.pCode = code.data();
+
+	VK_RETURN(vkCreateShaderModule(m_device, &createInfo, nullptr, &shader.m_shaderModule));
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDevice::createPipelineLayout(VkePipeline& pipeline, const VkPipelineLayoutCreateInfo& layoutInfo) {
+	// the layouts live in different descriptors, gather them now that they have been created
+	std::vector<VkDescriptorSetLayout> setLayouts;
+	for (VkeDescriptor* descriptor : pipeline.m_descriptors)
+		setLayouts.push_back(descriptor->m_descriptorSetLayout);
+
+	pipeline.applyReflection();
+
+	pipeline.m_layoutKey = {};
+	pipeline.m_layoutKey.add(layoutInfo.flags);
+	pipeline.m_layoutKey.addRange<VkDescriptorSetLayout>(setLayouts);
+	pipeline.m_layoutKey.addRange<VkPushConstantRange>(pipeline.m_pushConstantRanges);
+
+	if (m_pipelineRegistry.acquireLayout(pipeline.m_layoutKey, &pipeline.m_pipelineLayout))
+		return VK_SUCCESS;
+
+	// filled in a copy, the set layouts do not outlive this call
+	VkPipelineLayoutCreateInfo createInfo = layoutInfo;
+	createInfo.setLayoutCount = (uint32_t)setLayouts.size();
+	createInfo.pSetLayouts = setLayouts.data();
+	createInfo.pushConstantRangeCount = (uint32_t)pipeline.m_pushConstantRanges.size();
+	createInfo.pPushConstantRanges = pipeline.m_pushConstantRanges.data();
+
+	VK_RETURN(vkCreatePipelineLayout(m_device, &createInfo, nullptr, &pipeline.m_pipelineLayout));
+
+	m_pipelineRegistry.insertLayout(pipeline.m_layoutKey, pipeline.m_pipelineLayout);
 
 	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::createGraphicsPipeline(VkeGraphicsPipeline& pipeline) {
+	return createPipeline(pipeline, [this, &pipeline](VkPipeline* result) { return compileGraphicsPipeline(pipeline, result); });
+}
+
+VkResult VkeDevice::createComputePipeline(VkeComputePipeline& pipeline) {
+	return createPipeline(pipeline, [this, &pipeline](VkPipeline* result) { return compileComputePipeline(pipeline, result); });
+}
+
+VkResult VkeDevice::createGraphicsPipelineAsync(VkeGraphicsPipeline& pipeline, VkePipelineHandle* handle) {
+	return createPipelineAsync(
+		pipeline, m_graphicsFallback, [this, &pipeline](VkPipeline* result) { return compileGraphicsPipeline(pipeline, result); },
+		handle);
+}
+
+VkResult VkeDevice::createComputePipelineAsync(VkeComputePipeline& pipeline, VkePipelineHandle* handle) {
+	return createPipelineAsync(
+		pipeline, m_computeFallback, [this, &pipeline](VkPipeline* result) { return compileComputePipeline(pipeline, result); },
+		handle);
+}
+
+VkResult VkeDevice::warmupPipelines(std::span<VkeGraphicsPipeline*> graphicsPipelines,
+									std::span<VkeComputePipeline*> computePipelines, PipelineWarmupStats* stats) {
+	uint32_t cacheHitsBefore = m_pipelineCache.getStats().cacheHits;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<VkePipelineHandle> handles(graphicsPipelines.size() + computePipelines.size());
+	uint32_t count = 0;
+
+	for (VkeGraphicsPipeline* pipeline : graphicsPipelines)
+		VK_RETURN(createGraphicsPipelineAsync(*pipeline, &handles[count++]));
+
+	for (VkeComputePipeline* pipeline : computePipelines)
+		VK_RETURN(createComputePipelineAsync(*pipeline, &handles[count++]));
+
+	for (VkePipelineHandle& handle : handles)
+		VK_RETURN(handle.wait());
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	if (!stats)
+		return VK_SUCCESS;
+
+	stats->pipelines = count;
+	stats->wallMs = elapsed.count();
+	stats->cacheHits = m_pipelineCache.getStats().cacheHits - cacheHitsBefore;
+
+	// the same pipelines once more, one after the other on this thread and without the pipeline cache
+	auto compileSerially = [this](VkePipeline& pipeline, auto compile) {
+		{
+			std::lock_guard lock(m_pipelineMutex);
+
+			// pipelines the registry already had never needed their modules
+			for (VkeShader* shader : pipeline.m_shaders)
+				VK_RETURN(createShaderModule(*shader));
+			pipeline.updateShaderStages();
+		}
+
+		VkPipeline result = VK_NULL_HANDLE;
+		VK_RETURN(compile(&result));
+		vkDestroyPipeline(m_device, result, nullptr);
+
+		return VK_SUCCESS;
+	};
+
+	start = std::chrono::high_resolution_clock::now();
+
+	for (VkeGraphicsPipeline* pipeline : graphicsPipelines)
+		VK_RETURN(compileSerially(*pipeline, [&](VkPipeline* result) {
+			return compileGraphicsPipeline(*pipeline, result, false);
+		}));
+
+	for (VkeComputePipeline* pipeline : computePipelines)
+		VK_RETURN(compileSerially(*pipeline, [&](VkPipeline* result) {
+			return compileComputePipeline(*pipeline, result, false);
+		}));
+
+	elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats->serialMs = elapsed.count();
+
+	return VK_SUCCESS;
+}
+
+void VkeDevice::setFallbackPipeline(VkeGraphicsPipeline& pipeline) {
+	setFallback(pipeline, &m_graphicsFallback, &m_graphicsFallbackKey);
+}
+
+void VkeDevice::setFallbackPipeline(VkeComputePipeline& pipeline) {
+	setFallback(pipeline, &m_computeFallback, &m_computeFallbackKey);
+}
+
+void VkeDevice::setFallback(VkePipeline& pipeline, VkPipeline* fallback, vkutil::HashKey* fallbackKey) {
+	std::lock_guard lock(m_pipelineMutex);
+
+	// pipelines still compiling may have copied the previous one, it stays alive until the device goes away
+	if (*fallback) {
+		if (VkPipeline unused = m_pipelineRegistry.releasePipeline(*fallbackKey))
+			m_deletionQueue.pushPipeline(unused);
+	}
+
+	*fallback = VK_NULL_HANDLE;
+	*fallbackKey = pipeline.m_key;
+
+	if (!m_pipelineRegistry.acquirePipeline(pipeline.m_key, fallback))
+		fmt::println("Pipeline {} is not compiled, it cannot be a fallback", pipeline.m_name);
+}
+
+VkResult VkeDevice::preparePipeline(VkePipeline& pipeline, std::shared_ptr<std::promise<VkPipeline>>* promise) {
+	std::lock_guard lock(m_pipelineMutex);
+
 	VK_RETURN(createPipelineLayout(pipeline, pipeline.m_pipelineLayoutInfo));
 
+	pipeline.m_key = {};
+	pipeline.buildKey(pipeline.m_key);
+	pipeline.m_pending = {};
+
+	if (m_pipelineRegistry.acquirePipeline(pipeline.m_key, &pipeline.m_pipeline))
+		return VK_SUCCESS;
+
+	// the same state is already compiling, share its result
+	if (auto it = m_compilingPipelines.find(pipeline.m_key); it != m_compilingPipelines.end()) {
+		it->second._requests++;
+		pipeline.m_pending = it->second._future;
+		return VK_SUCCESS;
+	}
+
+	// only pipelines that actually compile need the shader modules
+	for (VkeShader* shader : pipeline.m_shaders)
+		VK_RETURN(createShaderModule(*shader));
+	pipeline.updateShaderStages();
+
+	*promise = std::make_shared<std::promise<VkPipeline>>();
+	pipeline.m_pending = (*promise)->get_future().share();
+
+	m_compilingPipelines[pipeline.m_key] = {._future = pipeline.m_pending, ._requests = 1};
+
+	return VK_SUCCESS;
+}
+
+void VkeDevice::finishPipeline(const vkutil::HashKey& key, VkPipeline result, std::promise<VkPipeline>& promise) {
+	{
+		std::lock_guard lock(m_pipelineMutex);
+
+		auto it = m_compilingPipelines.find(key);
+		if (result)
+			m_pipelineRegistry.insertPipeline(key, result, it->second._requests);
+
+		m_compilingPipelines.erase(it);
+	}
+
+	promise.set_value(result);
+}
+
+VkResult VkeDevice::createPipeline(VkePipeline& pipeline, std::function<VkResult(VkPipeline*)> compile) {
+	std::shared_ptr<std::promise<VkPipeline>> promise;
+	VK_RETURN(preparePipeline(pipeline, &promise));
+
+	if (promise) {
+		VkPipeline result = VK_NULL_HANDLE;
+		VkResult compileResult = compile(&result);
+		finishPipeline(pipeline.m_key, compileResult == VK_SUCCESS ? result : VK_NULL_HANDLE, *promise);
+		VK_RETURN(compileResult);
+	}
+
+	if (pipeline.m_pending.valid()) {
+		pipeline.m_pipeline = pipeline.m_pending.get();
+		pipeline.m_pending = {};
+	}
+
+	return pipeline.m_pipeline ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+}
+
+VkResult VkeDevice::createPipelineAsync(VkePipeline& pipeline, VkPipeline fallback, std::function<VkResult(VkPipeline*)> compile,
+										VkePipelineHandle* handle) {
+	std::shared_ptr<std::promise<VkPipeline>> promise;
+	VK_RETURN(preparePipeline(pipeline, &promise));
+
+	pipeline.m_fallback = fallback;
+
+	if (handle)
+		handle->future = pipeline.m_pending;
+
+	if (!promise)
+		return VK_SUCCESS;
+
+	m_jobSystem->runBackground([this, key = pipeline.m_key, compile, promise] {
+		VkPipeline result = VK_NULL_HANDLE;
+		if (compile(&result) != VK_SUCCESS)
+			result = VK_NULL_HANDLE;
+
+		finishPipeline(key, result, *promise);
+	});
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDevice::compileGraphicsPipeline(VkeGraphicsPipeline& pipeline, VkPipeline* result, bool cached) {
 	VkPipelineViewportStateCreateInfo viewportState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.pNext = nullptr,
@@ -173,24 +541,135 @@ VkResult VkeDevice::createGraphicsPipeline(VkeGraphicsPipeline& pipeline) {
 		.layout = pipeline.m_pipelineLayout,
 	};
 
-	VK_RETURN(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline.m_pipeline));
+	VkPipelineCreationFeedback feedback{};
+	VkPipelineCreationFeedbackCreateInfo feedbackInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+		.pNext = pipelineInfo.pNext,
+		.pPipelineCreationFeedback = &feedback,
+	};
+	pipelineInfo.pNext = &feedbackInfo;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	VkPipelineCache cache = cached ? m_pipelineCache.getCache() : VK_NULL_HANDLE;
+	VK_RETURN(vkCreateGraphicsPipelines(m_device, cache, 1, &pipelineInfo, nullptr, result));
 
-	m_deletionQueue.push_function([this, &pipeline] { vkDestroyPipeline(m_device, pipeline.m_pipeline, nullptr); });
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	if (!cached)
+		return VK_SUCCESS;
+
+	std::lock_guard lock(m_pipelineMutex);
+	m_pipelineCache.recordPipeline(pipeline.m_name, elapsed.count(), feedback);
 
 	return VK_SUCCESS;
 }
 
-VkResult VkeDevice::createComputePipeline(VkeComputePipeline& pipeline) {
-	VK_RETURN(createPipelineLayout(pipeline, pipeline.m_pipelineLayoutInfo));
+VkResult VkeDevice::compileComputePipeline(VkeComputePipeline& pipeline, VkPipeline* result, bool cached) {
+	VkPipelineCreationFeedback feedback{};
+	VkPipelineCreationFeedbackCreateInfo feedbackInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+		.pPipelineCreationFeedback = &feedback,
+	};
 
-	pipeline.m_computeInfo.layout = pipeline.m_pipelineLayout;
-	VK_RETURN(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipeline.m_computeInfo, nullptr, &pipeline.m_pipeline));
+	VkComputePipelineCreateInfo computeInfo = pipeline.m_computeInfo;
+	computeInfo.pNext = &feedbackInfo;
+	computeInfo.layout = pipeline.m_pipelineLayout;
 
-	m_deletionQueue.push_function([this, &pipeline] { vkDestroyPipeline(m_device, pipeline.m_pipeline, nullptr); });
+	auto start = std::chrono::high_resolution_clock::now();
+
+	VkPipelineCache cache = cached ? m_pipelineCache.getCache() : VK_NULL_HANDLE;
+	VK_RETURN(vkCreateComputePipelines(m_device, cache, 1, &computeInfo, nullptr, result));
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	if (!cached)
+		return VK_SUCCESS;
+
+	std::lock_guard lock(m_pipelineMutex);
+	m_pipelineCache.recordPipeline(pipeline.m_name, elapsed.count(), feedback);
 
 	return VK_SUCCESS;
 }
 
+VkResult VkeDevice::reloadGraphicsPipeline(VkeGraphicsPipeline& pipeline) {
+	auto replacement = std::make_shared<VkeGraphicsPipeline>(pipeline);
+	replacement->refreshShaders();
+
+	PipelineReload& reload = m_pipelineReloads.emplace_back(PipelineReload{._target = &pipeline, ._replacement = replacement});
+
+	VkResult result = createGraphicsPipelineAsync(*replacement, &reload._handle);
+	if (result != VK_SUCCESS)
+		m_pipelineReloads.pop_back();
+
+	return result;
+}
+
+VkResult VkeDevice::reloadComputePipeline(VkeComputePipeline& pipeline) {
+	auto replacement = std::make_shared<VkeComputePipeline>(pipeline);
+	replacement->refreshShaders();
+
+	PipelineReload& reload = m_pipelineReloads.emplace_back(PipelineReload{._target = &pipeline, ._replacement = replacement});
+
+	VkResult result = createComputePipelineAsync(*replacement, &reload._handle);
+	if (result != VK_SUCCESS)
+		m_pipelineReloads.pop_back();
+
+	return result;
+}
+
+bool VkeDevice::applyPipelineReloads(vkutil::DeletionQueue& queue) {
+	// swapped all at once, so a frame never mixes old and new pipelines
+	for (PipelineReload& reload : m_pipelineReloads) {
+		if (!reload._handle.isReady())
+			return false;
+	}
+
+	for (PipelineReload& reload : m_pipelineReloads) {
+		VkePipeline& replacement = *reload._replacement;
+
+		if (reload._handle.wait() != VK_SUCCESS) {
+			// keeps the old pipeline, only the layout reference of the failed build is dropped
+			fmt::println("Pipeline {} failed to reload, keeping the previous one", replacement.m_name);
+			std::lock_guard lock(m_pipelineMutex);
+			if (VkPipelineLayout unused = m_pipelineRegistry.releaseLayout(replacement.m_layoutKey))
+				queue.pushPipelineLayout(unused);
+			continue;
+		}
+
+		replacement.resolve();
+
+		// the old pipeline retires with the queue, i.e. once the frames still using it are done
+		releasePipeline(*reload._target, queue);
+
+		// only the base state is used to bind, the builder state of the target is rebuilt on the next reload
+		static_cast<VkePipeline&>(*reload._target) = replacement;
+
+		fmt::println("Pipeline {} reloaded", replacement.m_name);
+	}
+
+	for (PipelineReload& reload : m_pipelineReloads) {
+		for (VkeShader* shader : reload._replacement->m_shaders)
+			destroyShader(*shader);
+	}
+
+	m_pipelineReloads.clear();
+
+	return true;
+}
+
+void VkeDevice::releasePipeline(VkePipeline& pipeline, vkutil::DeletionQueue& queue) {
+	std::lock_guard lock(m_pipelineMutex);
+
+	if (VkPipeline unused = m_pipelineRegistry.releasePipeline(pipeline.m_key))
+		queue.pushPipeline(unused);
+
+	if (VkPipelineLayout unused = m_pipelineRegistry.releaseLayout(pipeline.m_layoutKey))
+		queue.pushPipelineLayout(unused);
+
+	pipeline.m_pipeline = VK_NULL_HANDLE;
+}
+
 VkResult VkeDevice::createDrawImage(VkExtent2D extent, AllocatedImage* image) {
 	VkExtent3D drawImageExtent = {
 		extent.width,
@@ -219,10 +698,7 @@ VkResult VkeDevice::createDrawImage(VkExtent2D extent, AllocatedImage* image) {
 
 	VK_RETURN(vkCreateImageView(m_device, &imageViewCreateInfo, nullptr, &image->imageView));
 
-	m_deletionQueue.push_function([this, image] {
-		vkDestroyImageView(m_device, image->imageView, nullptr);
-		vmaDestroyImage(m_allocator, image->image, image->allocation);
-	});
+	m_deletionQueue.pushImage(image->image, image->imageView, image->allocation);
 
 	return VK_SUCCESS;
 }
@@ -255,57 +731,386 @@ VkResult VkeDevice::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& f
 }
 
 VkResult VkeDevice::uploadMesh(GPUMeshBuffers* mesh, std::span<uint32_t> indices, std::span<Vertex> vertices) {
+	UploadToken token;
+	VK_RETURN(uploadMeshAsync(mesh, indices, vertices, &token));
+	return m_uploadBatchDepth > 0 ? VK_SUCCESS : waitUpload(token);
+}
+
+VkResult VkeDevice::uploadMeshAsync(GPUMeshBuffers* mesh, std::span<uint32_t> indices, std::span<Vertex> vertices,
+								   UploadToken* token) {
 	const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
 	const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
 
-	GPUMeshBuffers newSurface;
-	VK_RETURN(createBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-						   VMA_MEMORY_USAGE_GPU_ONLY, &newSurface.indexBuffer));
+	uint64_t firstVertex, firstIndex;
 
-	VK_RETURN(createBuffer(vertexBufferSize,
-						   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-							   VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-						   VMA_MEMORY_USAGE_GPU_ONLY, &newSurface.vertexBuffer));
+	if (!m_geometryArena._vertexRanges.allocate(vertices.size(), &firstVertex))
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
 
-	VkBufferDeviceAddressInfo deviceAdressInfo{
-		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-		.buffer = newSurface.vertexBuffer.buffer,
+	if (!m_geometryArena._indexRanges.allocate(indices.size(), &firstIndex)) {
+		m_geometryArena._vertexRanges.free(firstVertex, vertices.size());
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+
+	GPUMeshBuffers newSurface = {
+		.firstIndex = (uint32_t)firstIndex,
+		.indexCount = (uint32_t)indices.size(),
+		.vertexOffset = (int32_t)firstVertex,
+		.vertexCount = (uint32_t)vertices.size(),
+		.vertexBufferAddress = m_geometryArena._vertexBufferAddress,
 	};
 
-	newSurface.vertexBufferAddress = vkGetBufferDeviceAddress(m_device, &deviceAdressInfo);
+	VK_RETURN(stageBuffer(m_geometryArena._vertexBuffer.buffer, firstVertex * sizeof(Vertex), vertices.data(), vertexBufferSize));
+	VK_RETURN(stageBuffer(m_geometryArena._indexBuffer.buffer, firstIndex * sizeof(uint32_t), indices.data(), indexBufferSize));
+	VK_RETURN(uploadAsync(token));
 
-	AllocatedBuffer staging;
-	void* data;
+	*mesh = newSurface;
 
-	VK_RETURN(createStagingBuffer(vertexBufferSize + indexBufferSize, &staging, data));
+	return VK_SUCCESS;
+}
 
-	memcpy(data, vertices.data(), vertexBufferSize);
-	memcpy((char*)data + vertexBufferSize, indices.data(), indexBufferSize);
+VkResult VkeDevice::destroyMesh(GPUMeshBuffers* mesh, vkutil::DeletionQueue& queue) {
+	queue.pushRange(m_geometryArena._vertexRanges, mesh->vertexOffset, mesh->vertexCount);
+	queue.pushRange(m_geometryArena._indexRanges, mesh->firstIndex, mesh->indexCount);
 
-	immediateSubmit([&](VkCommandBuffer cmd) {
-		VkBufferCopy vertexCopy{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = vertexBufferSize,
-		};
+	*mesh = {};
 
-		VkBufferCopy indexCopy{
-			.srcOffset = vertexBufferSize,
-			.dstOffset = 0,
-			.size = indexBufferSize,
-		};
+	return VK_SUCCESS;
+}
 
-		vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1, &vertexCopy);
-		vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
-	});
+void VkeDevice::bindGeometryArena(VkCommandBuffer cmd) {
+	vkCmdBindIndexBuffer(cmd, m_geometryArena._indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
 
-	VK_RETURN(destroyBuffer(&staging));
+void VkeDevice::getGeometryArenaStats(VkeRangeAllocator::Stats* vertexStats, VkeRangeAllocator::Stats* indexStats) {
+	*vertexStats = m_geometryArena._vertexRanges.getStats();
+	*indexStats = m_geometryArena._indexRanges.getStats();
+}
 
-	*mesh = newSurface;
+VkResult VkeDevice::stageBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, size_t size) {
+	size_t staged = 0;
+
+	while (staged < size) {
+		size_t chunkSize = std::min(size - staged, (size_t)STAGING_CHUNK_SIZE);
+
+		VkeStagingRing::Allocation allocation;
+		while (!m_stagingRing.allocate(chunkSize, 16, &allocation)) {
+			m_stagingRing.recordStall();
+			VK_RETURN(flushUploads());
+		}
+
+		memcpy(allocation.data, (const char*)data + staged, chunkSize);
+
+		m_pendingBufferCopies.push_back({
+			._dst = dst,
+			._region = {.srcOffset = allocation.offset, .dstOffset = dstOffset + staged, .size = chunkSize},
+		});
+
+		staged += chunkSize;
+	}
 
 	return VK_SUCCESS;
 }
 
+VkResult VkeDevice::stageImage(AllocatedImage* image, const void* data) {
+	const VkExtent3D extent = image->imageExtent;
+	const size_t rowSize = extent.width * 4;
+	const uint32_t rowsPerChunk = std::max<uint32_t>(1, STAGING_CHUNK_SIZE / rowSize);
+
+	// filled twice in one batch, the image is only transitioned around the copies once
+	bool pending = false;
+	for (PendingImageCopy& copy : m_pendingImageCopies) {
+		if (copy._image == image->image) {
+			copy._lastChunk = false;
+			pending = true;
+		}
+	}
+
+	// the transfer queue cannot take over the image without a release from the graphics queue, but the whole level is
+	// replaced so its contents can be discarded; no barrier orders the copy after graphics work still sampling an image
+	// filled before, so restaging one waits for the graphics queue to be idle
+	VkImageLayout oldLayout = image->getState().layout;
+	if (m_transferQueueFamily != m_graphicsQueueFamily) {
+		if (!pending && oldLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+			VK_RETURN(vkQueueWaitIdle(m_graphicsQueue));
+
+		// an acquire of the replaced contents not recorded yet would clash with the one of this upload
+		std::erase_if(m_pendingImageAcquires,
+					  [&](const VkImageMemoryBarrier2& barrier) { return barrier.image == image->image; });
+
+		oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	for (uint32_t z = 0; z < extent.depth; z++) {
+		for (uint32_t row = 0; row < extent.height; row += rowsPerChunk) {
+			uint32_t rowCount = std::min(rowsPerChunk, extent.height - row);
+			size_t chunkSize = rowCount * rowSize;
+
+			VkeStagingRing::Allocation allocation;
+			while (!m_stagingRing.allocate(chunkSize, 16, &allocation)) {
+				m_stagingRing.recordStall();
+				VK_RETURN(flushUploads());
+			}
+
+			memcpy(allocation.data, (const char*)data + (z * extent.height + row) * rowSize, chunkSize);
+
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.bufferOffset = allocation.offset;
+			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyRegion.imageSubresource.mipLevel = 0;
+			copyRegion.imageSubresource.baseArrayLayer = 0;
+			copyRegion.imageSubresource.layerCount = 1;
+			copyRegion.imageOffset = {0, (int32_t)row, (int32_t)z};
+			copyRegion.imageExtent = {extent.width, rowCount, 1};
+
+			m_pendingImageCopies.push_back({
+				._image = image->image,
+				._region = copyRegion,
+				._oldLayout = oldLayout,
+				._firstChunk = !pending && z == 0 && row == 0,
+				._lastChunk = z + 1 == extent.depth && row + rowCount == extent.height,
+			});
+		}
+	}
+
+	// made visible to every later command once the upload is acquired, see submitUploads
+	VkeSubresourceState uploaded = {
+		.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		.access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.visibleStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+	};
+	vkutil::setImageState(*image, uploaded);
+
+	return VK_SUCCESS;
+}
+
+UploadContext& VkeDevice::getUploadContext() {
+	uint64_t completed;
+	VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_uploadTimeline, &completed));
+
+	for (UploadContext& context : m_uploadContexts)
+		if (context._submission <= completed)
+			return context;
+
+	UploadContext& context = m_uploadContexts.emplace_back();
+	VK_CHECK(createCommandPool(&context._commandPool, 0, m_transferQueueFamily));
+	VK_CHECK(allocateCommandBuffer(&context._commandBuffer, context._commandPool));
+
+	return context;
+}
+
+void VkeDevice::beginUploadBatch() { m_uploadBatchDepth++; }
+
+VkResult VkeDevice::endUploadBatch() {
+	assert(m_uploadBatchDepth > 0);
+
+	if (--m_uploadBatchDepth > 0)
+		return VK_SUCCESS;
+
+	return flushUploads();
+}
+
+VkResult VkeDevice::uploadAsync(UploadToken* token) {
+	if (m_uploadBatchDepth == 0)
+		return submitUploads(token);
+
+	// the batch is submitted as a whole, the staged data ends up in the next submission
+	bool pending = !m_pendingBufferCopies.empty() || !m_pendingImageCopies.empty();
+	token->value = pending ? m_uploadSubmission + 1 : m_uploadSubmission;
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDevice::submitUploads(UploadToken* token) {
+	if (m_pendingBufferCopies.empty() && m_pendingImageCopies.empty()) {
+		token->value = m_uploadSubmission;
+		return VK_SUCCESS;
+	}
+
+	UploadContext& context = getUploadContext();
+	VkCommandBuffer cmd = context._commandBuffer;
+	VkBuffer staging = m_stagingRing.getBuffer();
+
+	const bool transferOwnership = m_transferQueueFamily != m_graphicsQueueFamily;
+
+	VK_RETURN(vkResetCommandPool(m_device, context._commandPool, 0));
+
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_RETURN(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	for (PendingImageCopy& copy : m_pendingImageCopies)
+		if (copy._firstChunk)
+			vkutil::transitionImage(cmd, copy._image, copy._oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	for (PendingBufferCopy& copy : m_pendingBufferCopies)
+		vkCmdCopyBuffer(cmd, staging, copy._dst, 1, &copy._region);
+
+	for (PendingImageCopy& copy : m_pendingImageCopies)
+		vkCmdCopyBufferToImage(cmd, staging, copy._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy._region);
+
+	// release the written ranges to the graphics family, one barrier per destination buffer
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+
+	if (transferOwnership) {
+		for (PendingBufferCopy& copy : m_pendingBufferCopies) {
+			VkDeviceSize begin = copy._region.dstOffset;
+			VkDeviceSize end = copy._region.dstOffset + copy._region.size;
+
+			auto it = std::find_if(bufferBarriers.begin(), bufferBarriers.end(),
+								   [&](VkBufferMemoryBarrier2& barrier) { return barrier.buffer == copy._dst; });
+
+			if (it == bufferBarriers.end()) {
+				bufferBarriers.push_back({
+					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+					.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+					.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+					.srcQueueFamilyIndex = m_transferQueueFamily,
+					.dstQueueFamilyIndex = m_graphicsQueueFamily,
+					.buffer = copy._dst,
+					.offset = begin,
+					.size = end - begin,
+				});
+				continue;
+			}
+
+			VkDeviceSize mergedEnd = std::max(it->offset + it->size, end);
+			it->offset = std::min(it->offset, begin);
+			it->size = mergedEnd - it->offset;
+		}
+	}
+
+	for (PendingImageCopy& copy : m_pendingImageCopies) {
+		if (!copy._lastChunk)
+			continue;
+
+		imageBarriers.push_back({
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+			.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.dstStageMask = transferOwnership ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.dstAccessMask = transferOwnership ? VK_ACCESS_2_NONE : VK_ACCESS_2_SHADER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.srcQueueFamilyIndex = transferOwnership ? m_transferQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = transferOwnership ? m_graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED,
+			.image = copy._image,
+			.subresourceRange = vkinit::imageSubResourceRange(VK_IMAGE_ASPECT_COLOR_BIT),
+		});
+	}
+
+	VkMemoryBarrier2 memoryBarrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+	};
+
+	VkDependencyInfo depInfo = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = transferOwnership ? 0u : 1u,
+		.pMemoryBarriers = &memoryBarrier,
+		.bufferMemoryBarrierCount = (uint32_t)bufferBarriers.size(),
+		.pBufferMemoryBarriers = bufferBarriers.data(),
+		.imageMemoryBarrierCount = (uint32_t)imageBarriers.size(),
+		.pImageMemoryBarriers = imageBarriers.data(),
+	};
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+
+	VK_RETURN(vkEndCommandBuffer(cmd));
+
+	// the matching acquires are recorded by the graphics queue in acquireUploads
+	if (transferOwnership) {
+		for (VkBufferMemoryBarrier2 barrier : bufferBarriers) {
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+			m_pendingBufferAcquires.push_back(barrier);
+		}
+
+		for (VkImageMemoryBarrier2 barrier : imageBarriers) {
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+			m_pendingImageAcquires.push_back(barrier);
+		}
+	}
+
+	uint64_t submission = ++m_uploadSubmission;
+
+	VkCommandBufferSubmitInfo cmdInfo = vkinit::commandBufferSubmitInfo(cmd);
+	VkSemaphoreSubmitInfo signalInfo =
+		vkinit::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_uploadTimeline, submission);
+	VkSubmitInfo2 submit = vkinit::submitInfo(&cmdInfo, &signalInfo, nullptr);
+
+	VK_RETURN(vkQueueSubmit2(m_transferQueue, 1, &submit, VK_NULL_HANDLE));
+
+	context._submission = submission;
+	m_stagingRing.markSubmitted(submission);
+
+	m_pendingBufferCopies.clear();
+	m_pendingImageCopies.clear();
+
+	token->value = submission;
+
+	return VK_SUCCESS;
+}
+
+VkResult VkeDevice::flushUploads() {
+	UploadToken token;
+	VK_RETURN(submitUploads(&token));
+	return waitUpload(token);
+}
+
+bool VkeDevice::isUploadComplete(UploadToken token) {
+	uint64_t completed;
+	VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_uploadTimeline, &completed));
+	return completed >= token.value;
+}
+
+VkResult VkeDevice::waitUpload(UploadToken token) {
+	// waiting on something still staged in a batch
+	if (token.value > m_uploadSubmission)
+		VK_RETURN(submitUploads(&token));
+
+	VkSemaphoreWaitInfo waitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &m_uploadTimeline,
+		.pValues = &token.value,
+	};
+
+	VK_RETURN(vkWaitSemaphores(m_device, &waitInfo, 9999999999));
+
+	m_stagingRing.retire(token.value);
+
+	return VK_SUCCESS;
+}
+
+VkSemaphoreSubmitInfo VkeDevice::acquireUploads(VkCommandBuffer cmd) {
+	if (!m_pendingBufferAcquires.empty() || !m_pendingImageAcquires.empty()) {
+		VkDependencyInfo depInfo = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = (uint32_t)m_pendingBufferAcquires.size(),
+			.pBufferMemoryBarriers = m_pendingBufferAcquires.data(),
+			.imageMemoryBarrierCount = (uint32_t)m_pendingImageAcquires.size(),
+			.pImageMemoryBarriers = m_pendingImageAcquires.data(),
+		};
+
+		vkCmdPipelineBarrier2(cmd, &depInfo);
+
+		m_pendingBufferAcquires.clear();
+		m_pendingImageAcquires.clear();
+	}
+
+	// the frame waits on the GPU for every upload submitted so far
+	return vkinit::semaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_uploadTimeline, m_uploadSubmission);
+}
+
 VkResult VkeDevice::createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocatedBuffer* buffer,
 								 bool temp) {
 	VkBufferCreateInfo bufferInfo = {
@@ -322,22 +1127,33 @@ VkResult VkeDevice::createBuffer(size_t allocSize, VkBufferUsageFlags usage, Vma
 
 	VK_RETURN(vmaCreateBuffer(m_allocator, &bufferInfo, &vmaallocInfo, &buffer->buffer, &buffer->allocation, &buffer->info));
 
-	if (!temp) {
-		auto bufferPtr = new AllocatedBuffer(*buffer);
-		m_deletionQueue.push_function([this, bufferPtr]() {
-			destroyBuffer(bufferPtr);
-			delete bufferPtr;
-		});
-	}
+	if (!temp)
+		m_deletionQueue.pushBuffer(*buffer);
 
 	return VK_SUCCESS;
 }
 
+VkResult VkeDevice::invalidateBuffer(AllocatedBuffer* buffer) {
+	return vmaInvalidateAllocation(m_allocator, buffer->allocation, 0, VK_WHOLE_SIZE);
+}
+
 VkResult VkeDevice::fillBuffer(AllocatedBuffer* buffer, void* data, size_t size) {
 	memcpy(buffer->allocation->GetMappedData(), data, size);
 	return VK_SUCCESS;
 }
 
+VkResult VkeDevice::initLinearAllocator(VkeLinearAllocator* allocator, AllocatedBuffer* buffer, VkDeviceSize offset,
+										VkDeviceSize size) {
+	const VkPhysicalDeviceLimits& limits = m_properties.limits;
+
+	if (offset % std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment) != 0)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	allocator->init(buffer, offset, size, limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+
+	return VK_SUCCESS;
+}
+
 VkResult VkeDevice::createStagingBuffer(size_t allocSize, AllocatedBuffer* staging, void*& data) {
 	VK_RETURN(createBuffer(allocSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, staging, true));
 	data = staging->allocation->GetMappedData();
@@ -350,7 +1166,7 @@ VkResult VkeDevice::destroyBuffer(AllocatedBuffer* buffer) {
 }
 
 VkResult VkeDevice::createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, AllocatedImage* handle,
-								bool mipmapped) {
+								bool mipmapped, bool temp) {
 	handle->imageFormat = format;
 	handle->imageExtent = size;
 
@@ -366,68 +1182,62 @@ VkResult VkeDevice::createImage(VkExtent3D size, VkFormat format, VkImageUsageFl
 
 	VK_RETURN(vmaCreateImage(m_allocator, &imgInfo, &allocInfo, &handle->image, &handle->allocation, nullptr));
 
-	VkImageAspectFlags aspectFlag = format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-	VkImageViewCreateInfo viewInfo = vkinit::imageViewCreateInfo(format, handle->image, aspectFlag);
+	handle->aspect = format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	handle->resetState(imgInfo.mipLevels, imgInfo.arrayLayers);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageViewCreateInfo(format, handle->image, handle->aspect);
 	viewInfo.subresourceRange.levelCount = imgInfo.mipLevels;
 
 	VK_RETURN(vkCreateImageView(m_device, &viewInfo, nullptr, &handle->imageView));
 
-	m_deletionQueue.push_function([this, handle] {
-		vkDestroyImageView(m_device, handle->imageView, nullptr);
-		vmaDestroyImage(m_allocator, handle->image, handle->allocation);
-	});
+	if (!temp)
+		m_deletionQueue.pushImage(handle->image, handle->imageView, handle->allocation);
 
 	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::fillImage(AllocatedImage* image, void* data) {
-	size_t imageSize = image->imageExtent.width * image->imageExtent.height * image->imageExtent.depth * 4;
-
-	AllocatedBuffer stagingBuffer;
-	VK_RETURN(createStagingBuffer(imageSize, &stagingBuffer, data));
-
-	immediateSubmit([&](VkCommandBuffer cmd) {
-		vkutil::transitionImage(cmd, image->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-		VkBufferImageCopy copyRegion = {};
-		copyRegion.bufferOffset = 0;
-		copyRegion.bufferRowLength = 0;
-		copyRegion.bufferImageHeight = 0;
-
-		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		copyRegion.imageSubresource.mipLevel = 0;
-		copyRegion.imageSubresource.baseArrayLayer = 0;
-		copyRegion.imageSubresource.layerCount = 1;
-		copyRegion.imageExtent = image->imageExtent;
-
-		vkCmdCopyBufferToImage(cmd, stagingBuffer.buffer, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-		vkutil::transitionImage(cmd, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-								VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	});
-
-	VK_RETURN(destroyBuffer(&stagingBuffer));
+	UploadToken token;
+	VK_RETURN(fillImageAsync(image, data, &token));
+	return m_uploadBatchDepth > 0 ? VK_SUCCESS : waitUpload(token);
+}
 
-	return VK_SUCCESS;
+VkResult VkeDevice::fillImageAsync(AllocatedImage* image, void* data, UploadToken* token) {
+	VK_RETURN(stageImage(image, data));
+	return uploadAsync(token);
 }
 
 VkResult VkeDevice::createFilledImage(AllocatedImage* image, void* data, VkExtent3D size, VkFormat format,
-									  VkImageUsageFlags usage) {
-	VK_RETURN(createImage(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, image, false));
+									  VkImageUsageFlags usage, bool temp) {
+	usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	VK_RETURN(createImage(size, format, usage, image, false, temp));
 	VK_RETURN(fillImage(image, data));
+
+	if (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+		VK_RETURN(m_bindlessHeap.registerImage(image->imageView, &image->bindlessIndex));
+
 	return VK_SUCCESS;
 }
 
-VkResult VkeDevice::destroyImage(AllocatedImage* image) {
-	vkDestroyImageView(m_device, image->imageView, nullptr);
-	vmaDestroyImage(m_allocator, image->image, image->allocation);
+VkResult VkeDevice::destroyImage(AllocatedImage* image, vkutil::DeletionQueue& queue) {
+	queue.pushImage(image->image, image->imageView, image->allocation);
+
+	// the slot is only rewritten once no frame can sample it anymore
+	if (image->bindlessIndex != VkeBindlessHeap::INVALID_HANDLE)
+		queue.pushBindlessImage(m_bindlessHeap, image->bindlessIndex);
+
+	*image = {};
+
 	return VK_SUCCESS;
 }
 
-VkResult VkeDevice::createSampler(VkSampler* sampler, VkSamplerCreateInfo* samplerInfo) {
+VkResult VkeDevice::createSampler(VkSampler* sampler, VkSamplerCreateInfo* samplerInfo, uint32_t* bindlessIndex) {
 	VK_RETURN(vkCreateSampler(m_device, samplerInfo, nullptr, sampler));
 
-	m_deletionQueue.push_function([this, sampler] { destroySampler(sampler); });
+	if (bindlessIndex)
+		VK_RETURN(m_bindlessHeap.registerSampler(*sampler, bindlessIndex));
+
+	m_deletionQueue.pushSampler(*sampler);
 
 	return VK_SUCCESS;
 }
@@ -440,44 +1250,84 @@ VkResult VkeDevice::destroySampler(VkSampler* sampler) {
 VkResult VkeDevice::initDescriptorSetLayout(VkeDescriptor* descriptorSet, VkShaderStageFlags shaderStages) {
 	VK_RETURN(descriptorSet->initLayout(m_device, shaderStages));
 
-	m_deletionQueue.push_function(
-		[this, descriptorSet] { vkDestroyDescriptorSetLayout(m_device, descriptorSet->m_descriptorSetLayout, nullptr); });
+	m_deletionQueue.pushDescriptorSetLayout(descriptorSet->m_descriptorSetLayout);
 
 	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::allocateDescriptorSet(VkeDescriptor* descriptorSet, VkeDescriptorAllocator* allocator, bool temp) {
-	VK_RETURN(allocator->allocate(m_device, descriptorSet));
+	VkDescriptorPool pool;
+	VK_RETURN(allocator->allocate(m_device, descriptorSet, &pool));
 
-	if (!temp) {
-		m_deletionQueue.push_function([this, allocator, descriptorSet] {
-			vkFreeDescriptorSets(m_device, allocator->m_pool, 1, &descriptorSet->m_descriptorSet);
-		});
-	}
+	if (!temp)
+		m_deletionQueue.pushDescriptorSet(pool, descriptorSet->m_descriptorSet);
 
 	return VK_SUCCESS;
 }
 
+VkResult VkeDevice::getCachedDescriptorSet(VkeDescriptor* descriptorSet) {
+	return m_descriptorCache.getDescriptorSet(m_device, descriptorSet);
+}
+
 VkResult VkeDevice::initDescriptorPool(VkeDescriptorAllocator* allocator, uint32_t maxSets,
 									   std::span<VkeDescriptorAllocator::PoolSizeRatio> poolRatios) {
 	VK_RETURN(allocator->initPool(m_device, maxSets, poolRatios));
 
-	m_deletionQueue.push_function([this, allocator] { destroyDescriptorPool(allocator); });
+	// pools are created lazily, so they are destroyed with the allocator instead of the deletion queue
+	m_descriptorAllocators.push_back(allocator);
 
 	return VK_SUCCESS;
 }
 
 VkResult VkeDevice::destroyDescriptorPool(VkeDescriptorAllocator* allocator) {
-	allocator->destroyPoll(m_device);
+	allocator->destroyPools(m_device);
+	std::erase(m_descriptorAllocators, allocator);
 	return VK_SUCCESS;
 }
 
+void VkeDevice::flushDeletionQueue(vkutil::DeletionQueue& queue) { queue.flush(m_device, m_allocator); }
+
 VkResult VkeDevice::resetDescriptorPool(VkeDescriptorAllocator* allocator) { return allocator->resetDescriptorPool(m_device); }
 
+void VkeDevice::initRenderGraph(VkeRenderGraph* graph) { graph->init(m_device, m_allocator); }
+
+void VkeDevice::destroyRenderGraph(VkeRenderGraph* graph) { graph->destroy(); }
+
+VkResult VkeDevice::initGpuProfiler(VkeGpuProfiler* profiler, uint32_t frameCount) {
+	uint32_t familyCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_chosenGPU, &familyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_chosenGPU, &familyCount, families.data());
+
+	uint32_t validBits = families[m_graphicsQueueFamily].timestampValidBits;
+	if (validBits == 0 || !m_properties.limits.timestampComputeAndGraphics) {
+		fmt::println("The graphics queue has no timestamps, GPU profiling is disabled");
+		return VK_SUCCESS;
+	}
+
+	return profiler->init(m_device, m_properties.limits.timestampPeriod, validBits, frameCount);
+}
+
+void VkeDevice::destroyGpuProfiler(VkeGpuProfiler* profiler) { profiler->destroy(); }
+
 void VkeDevice::destroy() {
-	m_deletionQueue.flush();
+	if (m_pipelineCache.save() != VK_SUCCESS)
+		fmt::println("Failed to write the pipeline cache");
+	m_pipelineCache.destroy();
+	m_pipelineRegistry.destroy(m_device);
+	m_shaderArchive.close();
+
+	m_deletionQueue.flush(m_device, m_allocator);
+
+	for (VkeDescriptorAllocator* allocator : m_descriptorAllocators)
+		allocator->destroyPools(m_device);
+	m_descriptorAllocators.clear();
+
+	vmaDestroyAllocator(m_allocator);
 
-	vkDestroySurfaceKHR(m_vkInstance, m_surface, nullptr);
+	if (m_surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(m_vkInstance, m_surface, nullptr);
 
 	vkDestroyDevice(m_device, nullptr);
 	vkb::destroy_debug_utils_messenger(m_vkInstance, m_debugMessenger);
@@ -1,7 +1,18 @@
 #pragma once
 
+#include "vke_bindless.hpp"
+#include "vke_descriptor_cache.hpp"
 #include "vke_descriptors.hpp"
+#include "vke_gpu_profiler.hpp"
+#include "vke_linear_allocator.hpp"
+#include "vke_pipeline_cache.hpp"
+#include "vke_pipeline_registry.hpp"
 #include "vke_pipelines.hpp"
+#include "vke_range_allocator.hpp"
+#include "vke_render_graph.hpp"
+#include "vke_shader_archive.hpp"
+#include "vke_staging_ring.hpp"
+#include "vke_job_system.hpp"
 #include "vke_utils.hpp"
 #include "vke_window.hpp"
 #include "vke_swapchain.hpp"
@@ -9,12 +20,80 @@
 
 namespace vke {
 
+constexpr uint32_t GEOMETRY_ARENA_VERTICES = 1 << 20;
+constexpr uint32_t GEOMETRY_ARENA_INDICES = 1 << 22;
+
+constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+constexpr VkDeviceSize STAGING_CHUNK_SIZE = 8 * 1024 * 1024; // larger uploads are split
+
 struct ImmediateData {
 	VkCommandBuffer _commandBuffer;
 	VkCommandPool _commandPool;
 	VkFence _fence;
 };
 
+// every mesh lives in these two buffers, so a single index buffer bind covers all the draws
+struct GeometryArena {
+	AllocatedBuffer _vertexBuffer;
+	AllocatedBuffer _indexBuffer;
+	VkDeviceAddress _vertexBufferAddress;
+
+	VkeRangeAllocator _vertexRanges; // in vertices
+	VkeRangeAllocator _indexRanges;	 // in indices
+};
+
+struct PendingBufferCopy {
+	VkBuffer _dst;
+	VkBufferCopy _region;
+};
+
+struct PendingImageCopy {
+	VkImage _image;
+	VkBufferImageCopy _region;
+	VkImageLayout _oldLayout; // tracked layout the first chunk transitions from
+	bool _firstChunk; // transitions the image before the copy
+	bool _lastChunk;  // makes the image shader readable after the copy
+};
+
+// upload work recorded on the transfer queue, reusable once its timeline value is reached
+struct UploadContext {
+	VkCommandPool _commandPool;
+	VkCommandBuffer _commandBuffer;
+	uint64_t _submission;
+};
+
+struct PipelineWarmupStats {
+	uint32_t pipelines;
+	uint32_t cacheHits; // of the parallel pass, a warm cache makes it look better than the serial one
+	double wallMs;
+	double serialMs; // the same pipelines compiled again one after the other, bypassing the pipeline cache
+};
+
+struct DeviceMemoryStats {
+	uint32_t allocations;
+	VkDeviceSize allocationBytes;
+	uint32_t blocks; // device memory objects the allocations are placed in
+	VkDeviceSize blockBytes;
+};
+
+// pipeline state already compiling on a worker, later requests for it share the result
+struct CompilingPipeline {
+	std::shared_future<VkPipeline> _future;
+	uint32_t _requests;
+};
+
+// replacement compiled on the worker pool for a pipeline whose shaders changed
+struct PipelineReload {
+	VkePipeline* _target;
+	std::shared_ptr<VkePipeline> _replacement;
+	VkePipelineHandle _handle;
+};
+
+// completion token of an asynchronous upload, i.e. a value of the upload timeline semaphore
+struct UploadToken {
+	uint64_t value{0};
+};
+
 class VkeDevice {
 
 	friend class VkeSwapchain;
@@ -22,66 +101,183 @@ class VkeDevice {
 public:
 	VkeDevice(){};
 
-	VkResult init(VkeWindow* window);
+	// without a window the device is selected headless, there is no surface to present to; pipelines compile as
+	// background jobs, the job system has to be drained before the device is destroyed
+	VkResult init(VkeWindow* window, VkeJobSystem* jobSystem, const char* pipelineCachePath = "pipeline_cache.bin",
+				  const char* shaderArchivePath = "shaders/shaders.pak");
 	void destroy();
 
 	void waitIdle() { vkDeviceWaitIdle(m_device); }
+	void newFrame();
+	void flushDeletionQueue(vkutil::DeletionQueue& queue);
 
 	VkDevice getDevice() { return m_device; }
+	const VkPhysicalDeviceProperties& getProperties() { return m_properties; }
+	VkeBindlessHeap& getBindlessHeap() { return m_bindlessHeap; }
+	VkePipelineCache::Stats getPipelineCacheStats() { return m_pipelineCache.getStats(); }
+	VkePipelineRegistry::Stats getPipelineRegistryStats() { return m_pipelineRegistry.getStats(); }
+	DeviceMemoryStats getMemoryStats();
 
 public:
 public:
 	VkResult createCommandPool(VkCommandPool* pool, VkCommandPoolCreateFlags flags = 0);
-	VkResult allocateCommandBuffer(VkCommandBuffer* buffer, VkCommandPool pool);
+	VkResult createCommandPool(VkCommandPool* pool, VkCommandPoolCreateFlags flags, uint32_t queueFamily);
+	VkResult allocateCommandBuffer(VkCommandBuffer* buffer, VkCommandPool pool,
+								   VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	VkResult createSemaphore(VkSemaphore* semaphore, VkSemaphoreCreateFlags flags = 0);
+	VkResult createTimelineSemaphore(VkSemaphore* semaphore, uint64_t initialValue = 0);
 	VkResult createFence(VkFence* fence, VkFenceCreateFlags flags = 0);
-	VkResult createShader(VkeShader& shader, const char* path);
+	VkResult createShader(VkeShader& shader, const char* path); // the module is only created once a pipeline needs it
 	VkResult destroyShader(VkeShader& shader);
-	VkResult createPipelineLayout(VkePipeline& pipeline, VkPipelineLayoutCreateInfo& layoutInfo);
+	VkResult createPipelineLayout(VkePipeline& pipeline, const VkPipelineLayoutCreateInfo& layoutInfo);
 	VkResult createGraphicsPipeline(VkeGraphicsPipeline& pipeline);
 	VkResult createComputePipeline(VkeComputePipeline& pipeline);
+	void releasePipeline(VkePipeline& pipeline, vkutil::DeletionQueue& queue); // destroyed with the queue once unused
+
+	// compiled on the worker pool, builders and their shader modules have to stay alive until the handle is ready
+	VkResult createGraphicsPipelineAsync(VkeGraphicsPipeline& pipeline, VkePipelineHandle* handle = nullptr);
+	VkResult createComputePipelineAsync(VkeComputePipeline& pipeline, VkePipelineHandle* handle = nullptr);
+	// with stats, every pipeline is compiled a second time serially without the cache, only meant for measurements
+	VkResult warmupPipelines(std::span<VkeGraphicsPipeline*> graphicsPipelines, std::span<VkeComputePipeline*> computePipelines,
+							 PipelineWarmupStats* stats = nullptr);
+
+	// hot reload, replacements compile in the background while the current pipelines keep drawing
+	VkResult reloadShader(VkeShader& shader); // from its loose file, which hot reload recompiles
+	VkResult reloadGraphicsPipeline(VkeGraphicsPipeline& pipeline);
+	VkResult reloadComputePipeline(VkeComputePipeline& pipeline);
+	bool isReloadPending() { return !m_pipelineReloads.empty(); }
+	bool applyPipelineReloads(vkutil::DeletionQueue& queue); // at a frame boundary, false while replacements compile
+
+	// bound instead of pipelines still compiling, they must share its layout; the device holds a registry reference of
+	// its own, so the fallback outlives reloads and releases of the pipeline it was taken from
+	void setFallbackPipeline(VkeGraphicsPipeline& pipeline);
+	void setFallbackPipeline(VkeComputePipeline& pipeline);
 	VkResult createDrawImage(VkExtent2D extent, AllocatedImage* image);
 	VkResult submitCommand(int submitCount, VkSubmitInfo2* submitInfo, VkFence fence = VK_NULL_HANDLE);
 	VkResult immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 
+	VkResult stageBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, size_t size);
+	// with a dedicated transfer family, restaging an image that was filled before waits for the graphics queue to be idle
+	VkResult stageImage(AllocatedImage* image, const void* data);
+	void beginUploadBatch();
+	VkResult endUploadBatch();
+	VkResult uploadAsync(UploadToken* token);
+	VkResult flushUploads();
+	bool isUploadComplete(UploadToken token);
+	VkResult waitUpload(UploadToken token);
+	// records the acquires of every upload submitted so far, the wait it returns belongs in the same graphics submission
+	VkSemaphoreSubmitInfo acquireUploads(VkCommandBuffer cmd);
+	VkeStagingRing::Stats getStagingStats() { return m_stagingRing.getStats(); }
+
 	VkResult uploadMesh(GPUMeshBuffers* mesh, std::span<uint32_t> indices, std::span<Vertex> vertices);
+	VkResult uploadMeshAsync(GPUMeshBuffers* mesh, std::span<uint32_t> indices, std::span<Vertex> vertices,
+							 UploadToken* token);
+	// the ranges return to the arena with the queue, once the frames that may still draw the mesh are done
+	VkResult destroyMesh(GPUMeshBuffers* mesh, vkutil::DeletionQueue& queue);
+	void bindGeometryArena(VkCommandBuffer cmd);
+	void getGeometryArenaStats(VkeRangeAllocator::Stats* vertexStats, VkeRangeAllocator::Stats* indexStats);
 
 	VkResult createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, AllocatedBuffer* buffer,
 						  bool temp = false);
 	VkResult fillBuffer(AllocatedBuffer* buffer, void* data, size_t size);
+	VkResult invalidateBuffer(AllocatedBuffer* buffer); // before the host reads what the GPU wrote to a mapped buffer
+	VkResult initLinearAllocator(VkeLinearAllocator* allocator, AllocatedBuffer* buffer, VkDeviceSize offset,
+								 VkDeviceSize size);
 	VkResult createStagingBuffer(size_t allocSize, AllocatedBuffer* buffer, void*& data);
 	VkResult destroyBuffer(AllocatedBuffer* buffer);
 
+	// like buffers, temp images are not destroyed with the device but by destroyImage
 	VkResult createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, AllocatedImage* handle,
-						 bool mipmapped = false);
+						 bool mipmapped = false, bool temp = false);
 	VkResult fillImage(AllocatedImage* image, void* data);
-	VkResult createFilledImage(AllocatedImage* image, void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage);
-	VkResult destroyImage(AllocatedImage* image);
+	VkResult fillImageAsync(AllocatedImage* image, void* data, UploadToken* token);
+	VkResult createFilledImage(AllocatedImage* image, void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+							   bool temp = false);
+	// of temp images, image, view and bindless handle go away with the queue once the frames that may sample it are done
+	VkResult destroyImage(AllocatedImage* image, vkutil::DeletionQueue& queue);
 
-	VkResult createSampler(VkSampler* sampler, VkSamplerCreateInfo* info);
+	VkResult createSampler(VkSampler* sampler, VkSamplerCreateInfo* info, uint32_t* bindlessIndex = nullptr);
 	VkResult destroySampler(VkSampler* sampler);
 
 	VkResult initDescriptorSetLayout(VkeDescriptor* descriptorSet, VkShaderStageFlags shaderStages);
 	VkResult allocateDescriptorSet(VkeDescriptor* descriptorSet, VkeDescriptorAllocator* allocator, bool temp = false);
+	VkResult getCachedDescriptorSet(VkeDescriptor* descriptorSet); // owned by the cache, valid for a few frames once unused
+	VkeDescriptorCache::Stats getDescriptorCacheStats() { return m_descriptorCache.getStats(); }
+	// of the pools behind the cache, which never resets them, so sets are counted since startup
+	VkeDescriptorAllocator::Stats getDescriptorAllocatorStats() { return m_descriptorCache.m_allocator.getStats(); }
 	VkResult initDescriptorPool(VkeDescriptorAllocator* descriptorAllocator, uint32_t maxSets,
 								std::span<VkeDescriptorAllocator::PoolSizeRatio> poolRatios);
 	VkResult destroyDescriptorPool(VkeDescriptorAllocator* descriptorAllocator);
 	VkResult resetDescriptorPool(VkeDescriptorAllocator* descriptorAllocator);
 
+	void initRenderGraph(VkeRenderGraph* graph);
+	void destroyRenderGraph(VkeRenderGraph* graph); // the device has to be idle, transient memory is freed right away
+
+	VkResult initGpuProfiler(VkeGpuProfiler* profiler, uint32_t frameCount); // left disabled without graphics timestamps
+	void destroyGpuProfiler(VkeGpuProfiler* profiler);
+
 private:
 	VkInstance m_vkInstance;
 	VkDebugUtilsMessengerEXT m_debugMessenger;
-	VkSurfaceKHR m_surface;
+	VkSurfaceKHR m_surface{VK_NULL_HANDLE};
 	VkPhysicalDevice m_chosenGPU;
+	VkPhysicalDeviceProperties m_properties;
 	VkDevice m_device;
 	ImmediateData m_immData;
+	GeometryArena m_geometryArena;
+
+	VkeStagingRing m_stagingRing;
+
+	VkeBindlessHeap m_bindlessHeap;
+	VkePipelineCache m_pipelineCache;
+	VkePipelineRegistry m_pipelineRegistry;
+	VkeShaderArchive m_shaderArchive;
+
+	VkeJobSystem* m_jobSystem{nullptr};
+	std::mutex m_pipelineMutex; // guards the registry and the cache stats against the compile workers
+	std::unordered_map<vkutil::HashKey, CompilingPipeline, vkutil::HashKeyHasher> m_compilingPipelines;
+	VkPipeline m_graphicsFallback{VK_NULL_HANDLE};
+	VkPipeline m_computeFallback{VK_NULL_HANDLE};
+	vkutil::HashKey m_graphicsFallbackKey;
+	vkutil::HashKey m_computeFallbackKey;
+	std::vector<PipelineReload> m_pipelineReloads;
+
+	VkResult createShaderModule(VkeShader& shader);
+	VkResult preparePipeline(VkePipeline& pipeline, std::shared_ptr<std::promise<VkPipeline>>* promise);
+	void finishPipeline(const vkutil::HashKey& key, VkPipeline result, std::promise<VkPipeline>& promise);
+	void setFallback(VkePipeline& pipeline, VkPipeline* fallback, vkutil::HashKey* fallbackKey);
+	VkResult createPipeline(VkePipeline& pipeline, std::function<VkResult(VkPipeline*)> compile);
+	VkResult createPipelineAsync(VkePipeline& pipeline, VkPipeline fallback, std::function<VkResult(VkPipeline*)> compile,
+								 VkePipelineHandle* handle);
+	VkResult compileGraphicsPipeline(VkeGraphicsPipeline& pipeline, VkPipeline* result, bool cached = true);
+	VkResult compileComputePipeline(VkeComputePipeline& pipeline, VkPipeline* result, bool cached = true);
+	VkeDescriptorCache m_descriptorCache;
+	AllocatedBuffer m_stagingBuffer;
+	std::vector<PendingBufferCopy> m_pendingBufferCopies;
+	std::vector<PendingImageCopy> m_pendingImageCopies;
+
+	std::deque<UploadContext> m_uploadContexts;
+	VkSemaphore m_uploadTimeline;
+	uint64_t m_uploadSubmission{0};
+	uint32_t m_uploadBatchDepth{0}; // while > 0 uploads are only staged
+
+	// ownership acquires the graphics queue still has to record for finished uploads
+	std::vector<VkBufferMemoryBarrier2> m_pendingBufferAcquires;
+	std::vector<VkImageMemoryBarrier2> m_pendingImageAcquires;
 
 	VmaAllocator m_allocator;
 
 	VkQueue m_graphicsQueue;
 	uint32_t m_graphicsQueueFamily;
 
+	VkQueue m_transferQueue; // same as the graphics queue when there is no transfer family
+	uint32_t m_transferQueueFamily;
+
+	UploadContext& getUploadContext();
+	VkResult submitUploads(UploadToken* token);
+
 	vkutil::DeletionQueue m_deletionQueue;
+	std::vector<VkeDescriptorAllocator*> m_descriptorAllocators;
 };
 
 } // namespace vke
@@ -0,0 +1,159 @@
+#include "vke_gpu_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using namespace vke;
+
+VkeGpuProfiler::Scope::Scope(VkeGpuProfiler& profiler, VkCommandBuffer cmd, const char* name)
+	: m_profiler(profiler), m_cmd(cmd) {
+	Frame* frame = profiler.m_frame;
+	if (!frame || frame->scopes.size() >= GPU_PROFILER_MAX_SCOPES)
+		return;
+
+	m_query = frame->firstQuery + (uint32_t)frame->scopes.size() * 2;
+	frame->scopes.push_back(name);
+
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, profiler.m_queryPool, m_query);
+}
+
+VkeGpuProfiler::Scope::~Scope() {
+	// written once everything recorded inside the scope has completed
+	if (m_query != UINT32_MAX)
+		vkCmdWriteTimestamp2(m_cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_profiler.m_queryPool, m_query + 1);
+}
+
+VkResult VkeGpuProfiler::init(VkDevice device, double timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount) {
+	m_device = device;
+	m_timestampPeriod = timestampPeriod;
+	m_timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+
+	VkQueryPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = frameCount * GPU_PROFILER_MAX_SCOPES * 2,
+	};
+
+	VK_RETURN(vkCreateQueryPool(device, &poolInfo, nullptr, &m_queryPool));
+
+	return VK_SUCCESS;
+}
+
+void VkeGpuProfiler::destroy() {
+	if (m_queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+
+	m_queryPool = VK_NULL_HANDLE;
+	m_frame = nullptr;
+}
+
+void VkeGpuProfiler::initFrame(Frame* frame, uint32_t slot) {
+	*frame = {.firstQuery = slot * GPU_PROFILER_MAX_SCOPES * 2};
+}
+
+void VkeGpuProfiler::beginFrame(VkCommandBuffer cmd, Frame& frame) {
+	if (!isEnabled())
+		return;
+
+	collectFrame(frame);
+
+	frame.scopes.clear();
+	frame.frameIndex = m_frameIndex++;
+	frame.recorded = true;
+
+	vkCmdResetQueryPool(cmd, m_queryPool, frame.firstQuery, GPU_PROFILER_MAX_SCOPES * 2);
+
+	m_frame = &frame;
+}
+
+void VkeGpuProfiler::collectFrame(Frame& frame) {
+	if (!isEnabled() || !frame.recorded || frame.scopes.empty())
+		return;
+
+	frame.recorded = false;
+
+	// value and availability per query, a query the GPU never reached is skipped instead of waited on
+	uint32_t queryCount = (uint32_t)frame.scopes.size() * 2;
+	std::vector<uint64_t> results(queryCount * 2);
+
+	VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, frame.firstQuery, queryCount,
+											results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+											VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+		return;
+
+	for (size_t i = 0; i < frame.scopes.size(); i++) {
+		uint64_t begin = results[i * 4];
+		uint64_t end = results[i * 4 + 2];
+
+		if (!results[i * 4 + 1] || !results[i * 4 + 3])
+			continue;
+
+		if (!m_hasOrigin) {
+			m_traceOrigin = begin;
+			m_hasOrigin = true;
+		}
+
+		double durationNs = (double)((end - begin) & m_timestampMask) * m_timestampPeriod;
+		double startNs = (double)((begin - m_traceOrigin) & m_timestampMask) * m_timestampPeriod;
+
+		auto [it, inserted] = m_durations.try_emplace(frame.scopes[i]);
+		if (inserted)
+			m_scopeNames.push_back(frame.scopes[i]);
+
+		it->second.push_back(durationNs / 1e6);
+		if (it->second.size() > GPU_PROFILER_WINDOW)
+			it->second.pop_front();
+
+		m_events.push_back({frame.scopes[i], frame.frameIndex, startNs / 1e3, durationNs / 1e3});
+		if (m_events.size() > GPU_PROFILER_MAX_EVENTS)
+			m_events.pop_front();
+	}
+}
+
+std::vector<VkeGpuProfiler::ScopeStats> VkeGpuProfiler::getStats() {
+	std::vector<ScopeStats> stats;
+
+	for (const std::string& name : m_scopeNames) {
+		std::vector<double> durations(m_durations[name].begin(), m_durations[name].end());
+		std::sort(durations.begin(), durations.end());
+
+		double total = 0.0;
+		for (double duration : durations)
+			total += duration;
+
+		size_t p99 = (size_t)std::ceil(durations.size() * 0.99) - 1;
+
+		stats.push_back({
+			.name = name,
+			.samples = (uint32_t)durations.size(),
+			.minMs = durations.front(),
+			.avgMs = total / durations.size(),
+			.p99Ms = durations[p99],
+		});
+	}
+
+	return stats;
+}
+
+VkResult VkeGpuProfiler::writeChromeTrace(const char* path) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	// complete events on one track, the viewer nests the scopes by their times
+	file << "{\"traceEvents\":[";
+
+	for (size_t i = 0; i < m_events.size(); i++) {
+		const TraceEvent& event = m_events[i];
+		file << fmt::format("{}\n{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":{:.3f},\"dur\":{:.3f},"
+							"\"args\":{{\"frame\":{}}}}}",
+							i == 0 ? "" : ",", event.name, event.startUs, event.durationUs, event.frameIndex);
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	file.close();
+
+	return file.fail() ? VK_ERROR_INITIALIZATION_FAILED : VK_SUCCESS;
+}
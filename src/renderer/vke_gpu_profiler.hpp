@@ -0,0 +1,88 @@
+#pragma once
+
+#include "vke_types.hpp"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace vke {
+
+constexpr uint32_t GPU_PROFILER_MAX_SCOPES = 64; // per frame, later scopes are not timed
+constexpr uint32_t GPU_PROFILER_WINDOW = 256; // samples per scope kept for the rolling statistics
+constexpr size_t GPU_PROFILER_MAX_EVENTS = 65536; // kept for the trace, oldest dropped first
+
+// timestamps written around scopes of the frame command buffer, read back when the same frame slot is recorded again:
+// its fence has been waited on by then, so collecting never stalls
+class VkeGpuProfiler {
+	friend class VkeDevice;
+
+public:
+	// the queries of one frame in flight, kept in its FrameData
+	struct Frame {
+		uint32_t firstQuery;
+		std::vector<const char*> scopes; // a begin and an end query each, in recording order
+		uint64_t frameIndex;
+		bool recorded;
+	};
+
+	struct ScopeStats {
+		std::string name;
+		uint32_t samples;
+		double minMs;
+		double avgMs;
+		double p99Ms;
+	};
+
+	// names have to outlive the profiler, string literals are expected
+	class Scope {
+	public:
+		Scope(VkeGpuProfiler& profiler, VkCommandBuffer cmd, const char* name);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		VkeGpuProfiler& m_profiler;
+		VkCommandBuffer m_cmd;
+		uint32_t m_query{UINT32_MAX};
+	};
+
+	bool isEnabled() { return m_queryPool != VK_NULL_HANDLE; }
+
+	void initFrame(Frame* frame, uint32_t slot);
+	void beginFrame(VkCommandBuffer cmd, Frame& frame); // collects what the slot recorded last time, then reuses it
+	void collectFrame(Frame& frame); // once its fence has been waited on, for the frames still in flight at exit
+
+	std::vector<ScopeStats> getStats(); // in the order the scopes were first seen
+	VkResult writeChromeTrace(const char* path); // chrome://tracing and Perfetto read it
+
+private:
+	struct TraceEvent {
+		const char* name;
+		uint64_t frameIndex;
+		double startUs;
+		double durationUs;
+	};
+
+	VkDevice m_device;
+	VkQueryPool m_queryPool{VK_NULL_HANDLE};
+	double m_timestampPeriod; // nanoseconds per tick
+	uint64_t m_timestampMask;
+
+	Frame* m_frame{nullptr};
+	uint64_t m_frameIndex{0};
+
+	uint64_t m_traceOrigin{0}; // first timestamp read back, the trace starts there
+	bool m_hasOrigin{false};
+
+	std::vector<std::string> m_scopeNames;
+	std::unordered_map<std::string, std::deque<double>> m_durations; // milliseconds, newest last
+	std::deque<TraceEvent> m_events;
+
+	VkResult init(VkDevice device, double timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount);
+	void destroy();
+};
+
+} // namespace vke
@@ -4,6 +4,120 @@
 
 namespace vkutil {
 
+// accesses a later access has to wait for
+constexpr VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+										VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+										VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+static bool updateState(VkeSubresourceState& state, VkImageLayout layout, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+						VkImageMemoryBarrier2* barrier) {
+	VkAccessFlags2 writes = access & WRITE_ACCESS;
+	bool transition = state.layout != layout;
+
+	bool visible = (state.visibleStages & VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT) || !(stages & ~state.visibleStages);
+
+	// nothing to wait for, or a read of contents already visible to the stages reading them
+	bool redundant = !transition && (!state.stages || (!writes && visible));
+
+	if (!redundant) {
+		*barrier = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = state.stages,
+			.srcAccessMask = state.access,
+			.dstStageMask = stages,
+			.dstAccessMask = access,
+			.oldLayout = state.layout,
+			.newLayout = layout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		};
+	}
+
+	if (writes) {
+		state = {.layout = layout, .stages = stages, .access = writes};
+	} else {
+		// a transition is a write of its own, only the stages after it can see it
+		state.visibleStages = transition ? stages : state.visibleStages | (redundant ? 0 : stages);
+		state.stages |= stages;
+		state.layout = layout;
+	}
+
+	return !redundant;
+}
+
+static void submitImageBarriers(VkCommandBuffer cmd, std::span<const VkImageMemoryBarrier2> barriers) {
+	if (barriers.empty())
+		return;
+
+	VkDependencyInfo depInfo = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = (uint32_t)barriers.size(),
+		.pImageMemoryBarriers = barriers.data(),
+	};
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+void addImageBarriers(std::vector<VkImageMemoryBarrier2>& barriers, VkeImage& image, VkImageLayout layout,
+					  VkPipelineStageFlags2 stages, VkAccessFlags2 access, uint32_t baseMip, uint32_t mipCount, uint32_t baseLayer,
+					  uint32_t layerCount) {
+	uint32_t mipEnd = mipCount == VK_REMAINING_MIP_LEVELS ? image.mipLevels : baseMip + mipCount;
+	uint32_t layerEnd = layerCount == VK_REMAINING_ARRAY_LAYERS ? image.arrayLayers : baseLayer + layerCount;
+
+	size_t layerStart = barriers.size();
+
+	for (uint32_t layer = baseLayer; layer < layerEnd; layer++) {
+		size_t first = barriers.size();
+
+		for (uint32_t mip = baseMip; mip < mipEnd; mip++) {
+			VkImageMemoryBarrier2 barrier;
+			if (!updateState(image.getState(mip, layer), layout, stages, access, &barrier))
+				continue;
+
+			barrier.image = image.image;
+			barrier.subresourceRange = {image.aspect, mip, 1, layer, 1};
+
+			// consecutive mips coming from the same state share one barrier
+			VkImageMemoryBarrier2* last = barriers.size() > first ? &barriers.back() : nullptr;
+			if (last && last->srcStageMask == barrier.srcStageMask && last->srcAccessMask == barrier.srcAccessMask &&
+				last->oldLayout == barrier.oldLayout &&
+				last->subresourceRange.baseMipLevel + last->subresourceRange.levelCount == mip) {
+				last->subresourceRange.levelCount++;
+				continue;
+			}
+
+			barriers.push_back(barrier);
+		}
+
+		// and so do consecutive layers whose mips all did
+		if (barriers.size() != first + 1 || first == layerStart)
+			continue;
+
+		VkImageMemoryBarrier2& previous = barriers[first - 1];
+		VkImageMemoryBarrier2& current = barriers[first];
+		if (previous.srcStageMask == current.srcStageMask && previous.srcAccessMask == current.srcAccessMask &&
+			previous.oldLayout == current.oldLayout &&
+			previous.subresourceRange.baseMipLevel == current.subresourceRange.baseMipLevel &&
+			previous.subresourceRange.levelCount == current.subresourceRange.levelCount &&
+			previous.subresourceRange.baseArrayLayer + previous.subresourceRange.layerCount == layer) {
+			previous.subresourceRange.layerCount++;
+			barriers.pop_back();
+		}
+	}
+}
+
+void transitionImage(VkCommandBuffer cmd, VkeImage& image, VkImageLayout layout, VkPipelineStageFlags2 stages,
+					 VkAccessFlags2 access, uint32_t baseMip, uint32_t mipCount, uint32_t baseLayer, uint32_t layerCount) {
+	std::vector<VkImageMemoryBarrier2> barriers;
+	addImageBarriers(barriers, image, layout, stages, access, baseMip, mipCount, baseLayer, layerCount);
+	submitImageBarriers(cmd, barriers);
+}
+
+void setImageState(VkeImage& image, VkeSubresourceState state) {
+	for (VkeSubresourceState& subresource : image.subresources)
+		subresource = state;
+}
+
 void transitionImage(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout) {
 	VkImageMemoryBarrier2 imageBarrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
 	imageBarrier.pNext = nullptr;
@@ -65,33 +179,37 @@ void copyImageToImage(VkCommandBuffer cmd, VkImage source, VkImage destination,
 }
 
 void makeWriteable(VkCommandBuffer cmd, VkeImage& image) {
-	transitionImage(cmd, image.image, image.currentLayout, VK_IMAGE_LAYOUT_GENERAL);
-	image.currentLayout = VK_IMAGE_LAYOUT_GENERAL;
+	transitionImage(cmd, image, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+					VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
 }
 
 void makeColorWriteable(VkCommandBuffer buffer, VkeImage& image) {
-	transitionImage(buffer, image.image, image.currentLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	image.currentLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	transitionImage(buffer, image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+					VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
 }
 
 void makePresentable(VkCommandBuffer cmd, VkeImage& image) {
-	transitionImage(cmd, image.image, image.currentLayout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-	image.currentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// the semaphore signaled after the frame has to come after the transition
+	transitionImage(cmd, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE);
 }
 
 void makeTransferable(VkCommandBuffer cmd, VkeImage& image) {
-	transitionImage(cmd, image.image, image.currentLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-	image.currentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	transitionImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+					VK_ACCESS_2_TRANSFER_READ_BIT);
 }
 
 void makeCopyable(VkCommandBuffer cmd, VkeImage& image) {
-	transitionImage(cmd, image.image, image.currentLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	image.currentLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	transitionImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+					VK_ACCESS_2_TRANSFER_WRITE_BIT);
 }
 
 void copyImageToImage(VkCommandBuffer cmd, VkeImage& src, VkeImage& dst, VkExtent2D srcSize, VkExtent2D dstSize) {
-	makeTransferable(cmd, src);
-	makeCopyable(cmd, dst);
+	std::vector<VkImageMemoryBarrier2> barriers;
+	addImageBarriers(barriers, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+					 VK_ACCESS_2_TRANSFER_READ_BIT, 0, 1, 0, 1);
+	addImageBarriers(barriers, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+					 VK_ACCESS_2_TRANSFER_WRITE_BIT, 0, 1, 0, 1);
+	submitImageBarriers(cmd, barriers);
 
 	copyImageToImage(cmd, src.image, dst.image, srcSize, dstSize);
 }
@@ -9,6 +9,16 @@ void copyImageToImage(VkCommandBuffer cmd, VkImage source, VkImage destination,
 void copyImageToImage(VkCommandBuffer cmd, VkeImage& src, VkeImage& dst, VkExtent2D srcSize, VkExtent2D dstSize);
 void transitionImage(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
 
+// barriers for the next use of a range of subresources, nothing is added for the ones whose tracked state already allows it
+void addImageBarriers(std::vector<VkImageMemoryBarrier2>& barriers, VkeImage& image, VkImageLayout layout,
+					  VkPipelineStageFlags2 stages, VkAccessFlags2 access, uint32_t baseMip = 0,
+					  uint32_t mipCount = VK_REMAINING_MIP_LEVELS, uint32_t baseLayer = 0,
+					  uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
+void transitionImage(VkCommandBuffer cmd, VkeImage& image, VkImageLayout layout, VkPipelineStageFlags2 stages,
+					 VkAccessFlags2 access, uint32_t baseMip = 0, uint32_t mipCount = VK_REMAINING_MIP_LEVELS,
+					 uint32_t baseLayer = 0, uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
+void setImageState(VkeImage& image, VkeSubresourceState state); // for work the helpers did not record, like uploads
+
 void makeColorWriteable(VkCommandBuffer buffer, VkeImage& image);
 void makeWriteable(VkCommandBuffer buffer, VkeImage& image);
 void makePresentable(VkCommandBuffer buffer, VkeImage& image);
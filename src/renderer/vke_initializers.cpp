@@ -11,13 +11,13 @@ VkCommandPoolCreateInfo commandPoolCreateInfo(uint32_t queueFamilyIndex, VkComma
 	return info;
 };
 
-VkCommandBufferAllocateInfo commandBufferAllocateInfo(VkCommandPool pool, uint32_t count) {
+VkCommandBufferAllocateInfo commandBufferAllocateInfo(VkCommandPool pool, uint32_t count, VkCommandBufferLevel level) {
 	VkCommandBufferAllocateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	info.pNext = nullptr;
 	info.commandPool = pool;
 	info.commandBufferCount = count;
-	info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	info.level = level;
 	return info;
 }
 
@@ -73,14 +73,14 @@ VkSemaphoreCreateInfo semaphoreCreateInfo(VkSemaphoreCreateFlags flags) {
 	return info;
 };
 
-VkSemaphoreSubmitInfo semaphoreSubmitInfo(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore) {
+VkSemaphoreSubmitInfo semaphoreSubmitInfo(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore, uint64_t value) {
 	VkSemaphoreSubmitInfo info{};
 	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
 	info.pNext = nullptr;
 	info.semaphore = semaphore;
 	info.stageMask = stageMask;
 	info.deviceIndex = 0;
-	info.value = 1;
+	info.value = value;
 	return info;
 }
 
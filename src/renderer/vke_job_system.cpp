@@ -0,0 +1,274 @@
+#include "vke_job_system.hpp"
+
+#include <algorithm>
+
+using namespace vke;
+
+// deque the current thread pushes to and pops from, other threads share the main thread's one
+static thread_local uint32_t t_queue = 0;
+static thread_local bool t_mainThread = false;
+
+void VkeJobSystem::init(uint32_t workerCount) {
+	m_stopping = false;
+	t_mainThread = true;
+	t_queue = 0;
+
+	for (uint32_t i = 0; i <= workerCount; i++)
+		m_queues.emplace_back();
+
+	for (uint32_t i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&VkeJobSystem::workerLoop, this, i + 1);
+}
+
+void VkeJobSystem::destroy() {
+	// jobs may still depend on main thread ones
+	while (m_queued.load() > 0) {
+		runMainThreadJobs();
+		if (!runOne(t_queue, true))
+			std::this_thread::yield();
+	}
+
+	runMainThreadJobs();
+
+	{
+		std::lock_guard lock(m_sleepMutex);
+		m_stopping = true;
+	}
+
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+	m_queues.clear();
+}
+
+void VkeJobSystem::run(std::function<void()>&& job, VkeJobCounter* counter) {
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	push({std::move(job), counter});
+}
+
+void VkeJobSystem::runAfter(VkeJobCounter& dependency, std::function<void()>&& job, VkeJobCounter* counter) {
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		// checked under the lock the finishing job takes to release the continuations, so none is missed
+		std::lock_guard lock(dependency.m_mutex);
+		if (!dependency.isDone()) {
+			dependency.m_continuations.push_back({std::move(job), counter});
+			return;
+		}
+	}
+
+	push({std::move(job), counter});
+}
+
+void VkeJobSystem::runBackground(std::function<void()>&& job, VkeJobCounter* counter) {
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	pushBackground({std::move(job), counter});
+}
+
+void VkeJobSystem::runOnMainThread(std::function<void()>&& job, VkeJobCounter* counter) {
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	std::lock_guard lock(m_mainThreadMutex);
+	m_mainThreadJobs.push_back({std::move(job), counter});
+}
+
+void VkeJobSystem::wait(VkeJobCounter& counter) {
+	while (!counter.isDone()) {
+		if (t_mainThread)
+			runMainThreadJobs();
+
+		if (!runOne(t_queue, false))
+			std::this_thread::yield();
+	}
+
+	// the last job drops the counter to zero under the lock, once it is released the counter can be destroyed
+	std::lock_guard lock(counter.m_mutex);
+}
+
+void VkeJobSystem::runMainThreadJobs() {
+	std::vector<Job> jobs;
+
+	{
+		std::lock_guard lock(m_mainThreadMutex);
+		jobs.swap(m_mainThreadJobs);
+	}
+
+	for (Job& job : jobs) {
+		m_mainThreadCount.fetch_add(1, std::memory_order_relaxed);
+		execute(job);
+	}
+}
+
+void VkeJobSystem::parallelFor(uint32_t begin, uint32_t end, uint32_t grain,
+							   const std::function<void(uint32_t first, uint32_t last)>& function) {
+	VkeJobCounter counter;
+
+	for (uint32_t first = begin; first < end; first += grain) {
+		uint32_t last = std::min(first + grain, end);
+		run([&function, first, last] { function(first, last); }, &counter);
+	}
+
+	wait(counter);
+}
+
+bool VkeJobSystem::isMainThread() { return t_mainThread; }
+
+uint32_t VkeJobSystem::getThreadIndex() { return t_queue; }
+
+VkeJobSystem::Stats VkeJobSystem::getStats() {
+	return {
+		.jobs = m_jobCount.load(std::memory_order_relaxed),
+		.steals = m_stealCount.load(std::memory_order_relaxed),
+		.backgroundJobs = m_backgroundCount.load(std::memory_order_relaxed),
+		.mainThreadJobs = m_mainThreadCount.load(std::memory_order_relaxed),
+	};
+}
+
+void VkeJobSystem::push(Job&& job) {
+	{
+		WorkQueue& queue = m_queues[t_queue];
+		std::lock_guard lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	m_queued.fetch_add(1);
+	wakeWorker();
+}
+
+void VkeJobSystem::pushBackground(Job&& job) {
+	{
+		std::lock_guard lock(m_backgroundMutex);
+		m_backgroundJobs.push_back(std::move(job));
+	}
+
+	m_queued.fetch_add(1);
+	wakeWorker();
+}
+
+void VkeJobSystem::wakeWorker() {
+	// a worker going to sleep counts itself before it checks m_queued, one of the two always sees the other
+	if (m_sleeping.load() == 0)
+		return;
+
+	{
+		std::lock_guard lock(m_sleepMutex);
+	}
+
+	m_wake.notify_one();
+}
+
+bool VkeJobSystem::runOne(uint32_t queueIndex, bool background) {
+	Job job;
+	bool found = false;
+
+	// newest of the own jobs first, its data is likely still in cache
+	{
+		WorkQueue& queue = m_queues[queueIndex];
+		std::lock_guard lock(queue.mutex);
+
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// then the oldest job of another thread, starting with the next one so thieves spread out
+	for (uint32_t i = 1; !found && i < m_queues.size(); i++) {
+		WorkQueue& queue = m_queues[(queueIndex + i) % m_queues.size()];
+		std::lock_guard lock(queue.mutex);
+
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			found = true;
+
+			m_stealCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (!found && background) {
+		std::lock_guard lock(m_backgroundMutex);
+
+		if (!m_backgroundJobs.empty()) {
+			job = std::move(m_backgroundJobs.front());
+			m_backgroundJobs.pop_front();
+			found = true;
+
+			m_backgroundCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (!found)
+		return false;
+
+	m_queued.fetch_sub(1);
+	execute(job);
+
+	return true;
+}
+
+void VkeJobSystem::execute(Job& job) {
+	job.function();
+	m_jobCount.fetch_add(1, std::memory_order_relaxed);
+
+	finish(job.counter);
+}
+
+void VkeJobSystem::finish(VkeJobCounter* counter) {
+	if (!counter)
+		return;
+
+	// without the lock only while other jobs are certainly still pending
+	uint32_t pending = counter->m_pending.load(std::memory_order_relaxed);
+	while (pending > 1) {
+		if (counter->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+			return;
+	}
+
+	// possibly the last one: a waiter may destroy the counter as soon as it reads zero, nothing of it is touched after
+	// the lock is released, and wait takes the lock before returning
+	std::vector<VkeJobCounter::Continuation> continuations;
+
+	{
+		std::lock_guard lock(counter->m_mutex);
+		if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		continuations.swap(counter->m_continuations);
+	}
+
+	for (VkeJobCounter::Continuation& continuation : continuations)
+		push({std::move(continuation.function), continuation.counter});
+}
+
+void VkeJobSystem::workerLoop(uint32_t queue) {
+	t_queue = queue;
+
+	while (true) {
+		if (runOne(queue, true))
+			continue;
+
+		m_sleeping.fetch_add(1);
+
+		{
+			std::unique_lock lock(m_sleepMutex);
+			m_wake.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+		}
+
+		m_sleeping.fetch_sub(1);
+
+		if (m_stopping && m_queued.load() == 0)
+			return; // stopping with nothing left to run
+	}
+}
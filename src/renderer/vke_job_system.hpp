@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vke {
+
+class VkeJobSystem;
+
+// jobs still pending among the ones submitted with it, waiting on it runs other jobs meanwhile; it has to outlive a
+// wait on it, isDone alone does not say the last job is done with the counter
+class VkeJobCounter {
+	friend class VkeJobSystem;
+
+public:
+	bool isDone() { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	struct Continuation {
+		std::function<void()> function;
+		VkeJobCounter* counter;
+	};
+
+	std::atomic<uint32_t> m_pending{0};
+
+	std::mutex m_mutex; // guards the continuations, released once the counter reaches zero
+	std::vector<Continuation> m_continuations;
+};
+
+// workers with a deque each: a thread pushes and pops its own jobs at the back, idle threads steal from the front of
+// the others; the thread that calls init is the main thread, it owns a deque too and runs jobs while it waits
+class VkeJobSystem {
+public:
+	struct Stats {
+		uint64_t jobs;
+		uint64_t steals; // jobs run by another thread than the one that submitted them
+		uint64_t backgroundJobs;
+		uint64_t mainThreadJobs;
+	};
+
+	void init(uint32_t workerCount);
+	void destroy(); // runs every queued job first
+
+	void run(std::function<void()>&& job, VkeJobCounter* counter = nullptr);
+	void runAfter(VkeJobCounter& dependency, std::function<void()>&& job, VkeJobCounter* counter = nullptr);
+	// long jobs, like pipeline compiles: only idle workers take them, never a thread waiting on a counter
+	void runBackground(std::function<void()>&& job, VkeJobCounter* counter = nullptr);
+	// for what has to happen on the main thread, like queue submissions, run by runMainThreadJobs or a main thread wait
+	void runOnMainThread(std::function<void()>&& job, VkeJobCounter* counter = nullptr);
+
+	void wait(VkeJobCounter& counter);
+	void runMainThreadJobs();
+
+	// [begin, end) split in chunks of grain indices, returns once every chunk has run
+	void parallelFor(uint32_t begin, uint32_t end, uint32_t grain,
+					 const std::function<void(uint32_t first, uint32_t last)>& function);
+
+	bool isMainThread();
+	uint32_t getThreadIndex(); // 0 on the main thread and threads outside the job system, workers count from 1
+	uint32_t getWorkerCount() { return (uint32_t)m_workers.size(); }
+	uint32_t getThreadCount() { return getWorkerCount() + 1; } // with the main thread
+	Stats getStats();
+
+private:
+	struct Job {
+		std::function<void()> function;
+		VkeJobCounter* counter;
+	};
+
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::deque<WorkQueue> m_queues; // main thread first, then one per worker
+
+	std::mutex m_backgroundMutex;
+	std::deque<Job> m_backgroundJobs;
+
+	std::mutex m_mainThreadMutex;
+	std::vector<Job> m_mainThreadJobs;
+
+	// idle workers sleep until something is queued
+	std::atomic<uint32_t> m_queued{0};
+	std::atomic<uint32_t> m_sleeping{0};
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<bool> m_stopping{false};
+
+	std::atomic<uint64_t> m_jobCount{0};
+	std::atomic<uint64_t> m_stealCount{0};
+	std::atomic<uint64_t> m_backgroundCount{0};
+	std::atomic<uint64_t> m_mainThreadCount{0};
+
+	void push(Job&& job);
+	void pushBackground(Job&& job);
+	void wakeWorker();
+	bool runOne(uint32_t queue, bool background);
+	void execute(Job& job);
+	void finish(VkeJobCounter* counter);
+	void workerLoop(uint32_t queue);
+};
+
+} // namespace vke
@@ -0,0 +1,33 @@
+#include "vke_linear_allocator.hpp"
+
+using namespace vke;
+
+void VkeLinearAllocator::init(AllocatedBuffer* buffer, VkDeviceSize offset, VkDeviceSize size,
+							  VkDeviceSize uniformAlignment, VkDeviceSize storageAlignment) {
+	m_buffer = buffer->buffer;
+	m_mappedData = (char*)buffer->info.pMappedData;
+
+	m_begin = offset;
+	m_end = offset + size;
+	m_head = offset;
+	m_highWaterMark = 0;
+
+	m_uniformAlignment = uniformAlignment;
+	m_storageAlignment = storageAlignment;
+}
+
+VkResult VkeLinearAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation) {
+	VkDeviceSize offset = (m_head + alignment - 1) & ~(alignment - 1);
+
+	if (offset + size > m_end)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	m_head = offset + size;
+	m_highWaterMark = std::max(m_highWaterMark, m_head - m_begin);
+
+	allocation->buffer = m_buffer;
+	allocation->offset = offset;
+	allocation->data = m_mappedData + offset;
+
+	return VK_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vke_types.hpp"
+
+namespace vke {
+
+// bump allocator over a persistently mapped range of a buffer, reset once the GPU is done with it
+class VkeLinearAllocator {
+	friend class VkeDevice;
+
+public:
+	struct Allocation {
+		VkBuffer buffer;
+		VkDeviceSize offset; // from the start of the buffer, usable as a dynamic offset
+		void* data;
+	};
+
+	VkeLinearAllocator(){};
+
+	void reset() { m_head = m_begin; }
+
+	VkResult allocateUniform(VkDeviceSize size, Allocation* allocation) {
+		return allocate(size, m_uniformAlignment, allocation);
+	}
+
+	VkResult allocateStorage(VkDeviceSize size, Allocation* allocation) {
+		return allocate(size, m_storageAlignment, allocation);
+	}
+
+	template <typename T>
+	VkResult pushUniform(const T& data, Allocation* allocation) {
+		VK_RETURN(allocateUniform(sizeof(T), allocation));
+		memcpy(allocation->data, &data, sizeof(T));
+		return VK_SUCCESS;
+	}
+
+	VkDeviceSize getUsed() { return m_head - m_begin; }
+	VkDeviceSize getHighWaterMark() { return m_highWaterMark; }
+
+private:
+	VkBuffer m_buffer;
+	char* m_mappedData;
+
+	VkDeviceSize m_begin;
+	VkDeviceSize m_end;
+	VkDeviceSize m_head;
+	VkDeviceSize m_highWaterMark{0};
+
+	VkDeviceSize m_uniformAlignment;
+	VkDeviceSize m_storageAlignment;
+
+	void init(AllocatedBuffer* buffer, VkDeviceSize offset, VkDeviceSize size, VkDeviceSize uniformAlignment,
+			  VkDeviceSize storageAlignment);
+	VkResult allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation);
+};
+
+} // namespace vke
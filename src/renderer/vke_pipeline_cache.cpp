@@ -0,0 +1,96 @@
+#include "vke_pipeline_cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace vke;
+
+VkResult VkePipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, const char* path) {
+	m_device = device;
+	m_path = path;
+
+	std::vector<char> data;
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+	if (file.is_open()) {
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		file.close();
+
+		if (!isValid(data, properties)) {
+			fmt::println("Pipeline cache {} was created by another device or driver, starting empty", path);
+			data.clear();
+		}
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = data.size(),
+		.pInitialData = data.empty() ? nullptr : data.data(),
+	};
+
+	VK_RETURN(vkCreatePipelineCache(device, &cacheInfo, nullptr, &m_cache));
+
+	m_stats.loadedFromDisk = !data.empty();
+	m_stats.loadedBytes = data.size();
+
+	return VK_SUCCESS;
+}
+
+bool VkePipelineCache::isValid(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties) {
+	VkPipelineCacheHeaderVersionOne header;
+
+	if (data.size() < sizeof(header))
+		return false;
+
+	memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		   header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+		   memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkResult VkePipelineCache::save() {
+	size_t size;
+	VK_RETURN(vkGetPipelineCacheData(m_device, m_cache, &size, nullptr));
+
+	std::vector<char> data(size);
+	VK_RETURN(vkGetPipelineCacheData(m_device, m_cache, &size, data.data()));
+
+	// written next to the old file then renamed over it, a crash never leaves a truncated cache behind
+	std::string tmpPath = m_path + ".tmp";
+
+	std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	file.write(data.data(), size);
+	file.close();
+
+	if (file.fail())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, m_path, error);
+
+	if (error)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	return VK_SUCCESS;
+}
+
+void VkePipelineCache::destroy() { vkDestroyPipelineCache(m_device, m_cache, nullptr); }
+
+void VkePipelineCache::recordPipeline(const std::string& name, double ms, const VkPipelineCreationFeedback& feedback) {
+	bool valid = feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+	bool hit = valid && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT);
+
+	m_stats.pipelines++;
+	m_stats.cacheHits += hit;
+	m_stats.totalMs += ms;
+
+	fmt::println("Pipeline created: {} in {:.2f} ms ({})", name.empty() ? "unnamed" : name, ms,
+				 !valid ? "no feedback" : (hit ? "cache hit" : "cache miss"));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vke_types.hpp"
+
+#include <string>
+
+namespace vke {
+
+// VkPipelineCache persisted to disk, the file is only reused by the same driver and GPU
+class VkePipelineCache {
+	friend class VkeDevice;
+
+public:
+	struct Stats {
+		bool loadedFromDisk;
+		size_t loadedBytes;
+		uint32_t pipelines;
+		uint32_t cacheHits; // as reported by the driver through creation feedback
+		double totalMs;
+	};
+
+	VkPipelineCache getCache() { return m_cache; }
+	Stats getStats() { return m_stats; }
+
+private:
+	VkDevice m_device;
+	VkPipelineCache m_cache{VK_NULL_HANDLE};
+	std::string m_path;
+
+	Stats m_stats{};
+
+	VkResult init(VkDevice device, const VkPhysicalDeviceProperties& properties, const char* path);
+	VkResult save();
+	void destroy();
+
+	void recordPipeline(const std::string& name, double ms, const VkPipelineCreationFeedback& feedback);
+	bool isValid(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties);
+};
+
+} // namespace vke
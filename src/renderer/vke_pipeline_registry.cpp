@@ -0,0 +1,72 @@
+#include "vke_pipeline_registry.hpp"
+
+using namespace vke;
+
+bool VkePipelineRegistry::acquirePipeline(const vkutil::HashKey& key, VkPipeline* pipeline) {
+	m_stats.pipelineRequests++;
+
+	auto it = m_pipelines.find(key);
+	if (it == m_pipelines.end())
+		return false;
+
+	it->second.refCount++;
+	*pipeline = it->second.pipeline;
+
+	return true;
+}
+
+void VkePipelineRegistry::insertPipeline(const vkutil::HashKey& key, VkPipeline pipeline, uint32_t refCount) {
+	m_pipelines[key] = {.pipeline = pipeline, .refCount = refCount};
+	m_stats.uniquePipelines++;
+}
+
+VkPipeline VkePipelineRegistry::releasePipeline(const vkutil::HashKey& key) {
+	auto it = m_pipelines.find(key);
+	if (it == m_pipelines.end() || --it->second.refCount > 0)
+		return VK_NULL_HANDLE;
+
+	VkPipeline pipeline = it->second.pipeline;
+	m_pipelines.erase(it);
+
+	return pipeline;
+}
+
+bool VkePipelineRegistry::acquireLayout(const vkutil::HashKey& key, VkPipelineLayout* layout) {
+	m_stats.layoutRequests++;
+
+	auto it = m_layouts.find(key);
+	if (it == m_layouts.end())
+		return false;
+
+	it->second.refCount++;
+	*layout = it->second.layout;
+
+	return true;
+}
+
+void VkePipelineRegistry::insertLayout(const vkutil::HashKey& key, VkPipelineLayout layout) {
+	m_layouts[key] = {.layout = layout, .refCount = 1};
+	m_stats.uniqueLayouts++;
+}
+
+VkPipelineLayout VkePipelineRegistry::releaseLayout(const vkutil::HashKey& key) {
+	auto it = m_layouts.find(key);
+	if (it == m_layouts.end() || --it->second.refCount > 0)
+		return VK_NULL_HANDLE;
+
+	VkPipelineLayout layout = it->second.layout;
+	m_layouts.erase(it);
+
+	return layout;
+}
+
+void VkePipelineRegistry::destroy(VkDevice device) {
+	for (auto& [key, entry] : m_pipelines)
+		vkDestroyPipeline(device, entry.pipeline, nullptr);
+
+	for (auto& [key, entry] : m_layouts)
+		vkDestroyPipelineLayout(device, entry.layout, nullptr);
+
+	m_pipelines.clear();
+	m_layouts.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "vke_types.hpp"
+#include "vke_utils.hpp"
+
+#include <unordered_map>
+
+namespace vke {
+
+// shares pipelines and layouts between builders that end up with identical state, refcounted per request
+class VkePipelineRegistry {
+	friend class VkeDevice;
+
+public:
+	struct Stats {
+		uint32_t pipelineRequests;
+		uint32_t uniquePipelines;
+		uint32_t layoutRequests;
+		uint32_t uniqueLayouts;
+	};
+
+	Stats getStats() { return m_stats; }
+
+private:
+	struct Entry {
+		VkPipeline pipeline;
+		uint32_t refCount;
+	};
+
+	struct LayoutEntry {
+		VkPipelineLayout layout;
+		uint32_t refCount;
+	};
+
+	std::unordered_map<vkutil::HashKey, Entry, vkutil::HashKeyHasher> m_pipelines;
+	std::unordered_map<vkutil::HashKey, LayoutEntry, vkutil::HashKeyHasher> m_layouts;
+
+	Stats m_stats{};
+
+	bool acquirePipeline(const vkutil::HashKey& key, VkPipeline* pipeline);
+	void insertPipeline(const vkutil::HashKey& key, VkPipeline pipeline, uint32_t refCount = 1);
+	VkPipeline releasePipeline(const vkutil::HashKey& key); // returns the pipeline once unused, VK_NULL_HANDLE otherwise
+
+	bool acquireLayout(const vkutil::HashKey& key, VkPipelineLayout* layout);
+	void insertLayout(const vkutil::HashKey& key, VkPipelineLayout layout);
+	VkPipelineLayout releaseLayout(const vkutil::HashKey& key);
+
+	void destroy(VkDevice device);
+};
+
+} // namespace vke
@@ -2,6 +2,9 @@
 #include "vke_device.hpp"
 #include "vke_initializers.hpp"
 
+#include <algorithm>
+#include <array>
+
 using namespace vke;
 
 VkePipeline::VkePipeline() {
@@ -13,16 +16,122 @@ void VkePipeline::pushConstants(VkCommandBuffer cmd, GPUDrawPushConstants* const
 	vkCmdPushConstants(cmd, m_pipelineLayout, stage, 0, sizeof(GPUDrawPushConstants), constants);
 }
 
+VkPipeline VkePipeline::resolve() {
+	if (!m_pending.valid())
+		return m_pipeline;
+
+	// without a fallback there is nothing to draw with, stall until the pipeline is compiled
+	if (m_fallback && m_pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return m_fallback;
+
+	m_pipeline = m_pending.get();
+	m_pending = {};
+
+	if (!m_pipeline) {
+		fmt::println("Pipeline {} failed to compile, using its fallback", m_name);
+		m_pipeline = m_fallback;
+	}
+
+	return m_pipeline;
+}
+
+void VkePipeline::bindDescriptorSets(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint,
+									 std::span<const uint32_t> dynamicOffsets) {
+	if (m_descriptors.empty())
+		return;
+
+	// on the stack, this runs for every bind
+	std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> sets;
+	for (size_t i = 0; i < m_descriptors.size(); i++)
+		sets[i] = m_descriptors[i]->m_descriptorSet;
+
+	vkCmdBindDescriptorSets(cmd, bindPoint, m_pipelineLayout, 0, (uint32_t)m_descriptors.size(), sets.data(),
+							(uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
+}
+
 VkePipeline& VkePipeline::setDescriptorSet(VkeDescriptor& descriptorSet) {
-	m_descriptorLayouts.push_back(&descriptorSet.m_descriptorSetLayout);
-	m_descriptorSets.push_back(&descriptorSet.m_descriptorSet);
+	if (m_descriptors.size() == MAX_DESCRIPTOR_SETS) {
+		fmt::println("Pipeline {}: only {} descriptor sets can be bound", m_name, MAX_DESCRIPTOR_SETS);
+		return *this;
+	}
 
-	m_pipelineLayoutInfo.setLayoutCount = (uint32_t)m_descriptorLayouts.size();
-	m_pipelineLayoutInfo.pSetLayouts = *(m_descriptorLayouts.data());
+	m_descriptors.push_back(&descriptorSet);
 
 	return *this;
 }
 
+VkePipeline& VkePipeline::setName(const std::string& name) {
+	m_name = name;
+	return *this;
+}
+
+static bool compatibleTypes(VkDescriptorType declared, VkDescriptorType reflected) {
+	// dynamic offsets are invisible to the shader
+	if (declared == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+		declared = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	else if (declared == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+		declared = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	return declared == reflected;
+}
+
+bool VkePipeline::usesShader(const VkeShader& shader) {
+	return std::find(m_shaders.begin(), m_shaders.end(), &shader) != m_shaders.end();
+}
+
+void VkePipeline::refreshShaders() {
+	m_shaderHashes.clear();
+	m_reflection = {};
+
+	for (VkeShader* shader : m_shaders) {
+		m_shaderHashes.push_back(shader->getHash());
+		m_reflection.merge(shader->getReflection());
+	}
+}
+
+void VkePipeline::applyReflection() {
+	if (!m_explicitPushConstants)
+		m_pushConstantRanges.clear();
+
+	if (m_reflection.pushConstantSize > 0) {
+		if (m_pushConstantRanges.empty())
+			m_pushConstantRanges.push_back({m_reflection.pushConstantStages, 0, m_reflection.pushConstantSize});
+
+		bool covered = std::any_of(m_pushConstantRanges.begin(), m_pushConstantRanges.end(), [&](VkPushConstantRange range) {
+			return (range.stageFlags & m_reflection.pushConstantStages) == m_reflection.pushConstantStages &&
+				   range.offset + range.size >= m_reflection.pushConstantSize;
+		});
+
+		if (!covered)
+			fmt::println("Pipeline {}: push constant range does not cover the {} bytes used by the shaders", m_name,
+						 m_reflection.pushConstantSize);
+	}
+
+	for (const VkeShaderReflection::Binding& reflected : m_reflection.bindings) {
+		if (reflected.set >= m_descriptors.size()) {
+			fmt::println("Pipeline {}: shaders use set {} but only {} sets are bound", m_name, reflected.set,
+						 m_descriptors.size());
+			continue;
+		}
+
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings = m_descriptors[reflected.set]->m_bindings;
+		auto it = std::find_if(bindings.begin(), bindings.end(),
+							   [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == reflected.binding; });
+
+		if (it == bindings.end())
+			fmt::println("Pipeline {}: set {} binding {} is missing from the layout", m_name, reflected.set, reflected.binding);
+		else if (!compatibleTypes(it->descriptorType, reflected.type))
+			fmt::println("Pipeline {}: set {} binding {} is a {} in the layout but a {} in the shaders", m_name, reflected.set,
+						 reflected.binding, string_VkDescriptorType(it->descriptorType), string_VkDescriptorType(reflected.type));
+		else if (reflected.count > it->descriptorCount)
+			fmt::println("Pipeline {}: set {} binding {} holds {} descriptors, the shaders use {}", m_name, reflected.set,
+						 reflected.binding, it->descriptorCount, reflected.count);
+		else if ((it->stageFlags & reflected.stages) != reflected.stages)
+			fmt::println("Pipeline {}: set {} binding {} is not visible to every stage using it", m_name, reflected.set,
+						 reflected.binding);
+	}
+}
+
 // Graphics Pipeline
 VkeGraphicsPipeline::VkeGraphicsPipeline() {
 	m_shaderStages.clear();
@@ -40,21 +149,27 @@ VkeGraphicsPipeline::VkeGraphicsPipeline() {
 	m_renderInfo = {.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
 }
 
-void VkeGraphicsPipeline::bind(VkCommandBuffer cmd) {
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+void VkeGraphicsPipeline::bind(VkCommandBuffer cmd, std::span<const uint32_t> dynamicOffsets) {
+	bind(cmd, resolve(), dynamicOffsets);
+}
 
-	if (!m_descriptorSets.empty())
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, m_descriptorSets.size(),
-								*m_descriptorSets.data(), 0, nullptr);
+void VkeGraphicsPipeline::bind(VkCommandBuffer cmd, VkPipeline pipeline, std::span<const uint32_t> dynamicOffsets) {
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	bindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, dynamicOffsets);
 }
 
 VkeGraphicsPipeline& VkeGraphicsPipeline::setShaders(VkeShader& vertexShader, VkeShader& fragmentShader) {
-	m_shaderStages.clear();
-	m_shaderStages.push_back(vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertexShader.getModule()));
-	m_shaderStages.push_back(vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader.getModule()));
+	m_shaders = {&vertexShader, &fragmentShader};
+	refreshShaders();
 	return *this;
 }
 
+void VkeGraphicsPipeline::updateShaderStages() {
+	m_shaderStages.clear();
+	m_shaderStages.push_back(vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, m_shaders[0]->getModule()));
+	m_shaderStages.push_back(vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, m_shaders[1]->getModule()));
+}
+
 VkeGraphicsPipeline& VkeGraphicsPipeline::setInputTopology(VkPrimitiveTopology topology) {
 	m_inputAssembly.topology = topology;
 	m_inputAssembly.primitiveRestartEnable = VK_FALSE;
@@ -124,29 +239,60 @@ VkeGraphicsPipeline& VkeGraphicsPipeline::enableBlendingAdditive() { return *thi
 VkeGraphicsPipeline& VkeGraphicsPipeline::enableBlendingAlphablend() { return *this; }
 
 VkeGraphicsPipeline& VkeGraphicsPipeline::setPushConstantRange(VkPushConstantRange& bufferRange, uint32_t count) {
-	m_pipelineLayoutInfo.pushConstantRangeCount = count;
-	m_pipelineLayoutInfo.pPushConstantRanges = &bufferRange;
+	m_pushConstantRanges.assign(&bufferRange, &bufferRange + count);
+	m_explicitPushConstants = true;
 	return *this;
 }
 
+void VkeGraphicsPipeline::buildKey(vkutil::HashKey& key) {
+	key.add(VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout);
+	key.addRange<uint64_t>(m_shaderHashes);
+
+	key.add(m_inputAssembly.topology, m_inputAssembly.primitiveRestartEnable);
+
+	key.add(m_rasterizer.depthClampEnable, m_rasterizer.rasterizerDiscardEnable, m_rasterizer.polygonMode, m_rasterizer.cullMode,
+			m_rasterizer.frontFace, m_rasterizer.depthBiasEnable, m_rasterizer.depthBiasConstantFactor,
+			m_rasterizer.depthBiasClamp, m_rasterizer.depthBiasSlopeFactor, m_rasterizer.lineWidth);
+
+	key.add(m_multisampling.rasterizationSamples, m_multisampling.sampleShadingEnable, m_multisampling.minSampleShading,
+			m_multisampling.alphaToCoverageEnable, m_multisampling.alphaToOneEnable);
+
+	key.add(m_colorBlendAttachment);
+
+	key.add(m_depthStencil.depthTestEnable, m_depthStencil.depthWriteEnable, m_depthStencil.depthCompareOp,
+			m_depthStencil.depthBoundsTestEnable, m_depthStencil.stencilTestEnable, m_depthStencil.front, m_depthStencil.back,
+			m_depthStencil.minDepthBounds, m_depthStencil.maxDepthBounds);
+
+	key.add(m_renderInfo.colorAttachmentCount, m_renderInfo.depthAttachmentFormat, m_renderInfo.stencilAttachmentFormat);
+	key.addRange<VkFormat>({m_renderInfo.pColorAttachmentFormats, m_renderInfo.colorAttachmentCount});
+}
+
 // Compute Pipeline
 VkeComputePipeline::VkeComputePipeline() {
 	m_computeInfo = {.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
 	m_pipelineLayoutInfo = vkinit::computePipelineLayoutCreateInfo();
 }
 
-void VkeComputePipeline::bind(VkCommandBuffer cmd) {
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
-
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, m_descriptorSets.size(),
-							*m_descriptorSets.data(), 0, nullptr);
+void VkeComputePipeline::bind(VkCommandBuffer cmd, std::span<const uint32_t> dynamicOffsets) {
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, resolve());
+	bindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, dynamicOffsets);
 }
 
 VkeComputePipeline& VkeComputePipeline::setShader(VkeShader& computeShader) {
-	m_computeInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, computeShader.getModule());
+	m_shaders = {&computeShader};
+	refreshShaders();
 	return *this;
 }
 
+void VkeComputePipeline::updateShaderStages() {
+	m_computeInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, m_shaders[0]->getModule());
+}
+
+void VkeComputePipeline::buildKey(vkutil::HashKey& key) {
+	key.add(VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, m_computeInfo.flags);
+	key.addRange<uint64_t>(m_shaderHashes);
+}
+
 VkPushConstantRange vkutil::getPushConstantRange(VkShaderStageFlags stage, uint32_t size, uint32_t offset) {
 	return {
 		stage,
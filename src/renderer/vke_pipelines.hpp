@@ -4,29 +4,69 @@
 #include "vke_shader.hpp"
 #include "vke_swapchain.hpp"
 #include "vke_types.hpp"
+#include "vke_utils.hpp"
+
+#include <future>
 
 namespace vke {
 
+// future-like handle of a pipeline compiled on the worker pool, ready right away when it was already compiled
+struct VkePipelineHandle {
+	std::shared_future<VkPipeline> future;
+
+	bool isReady() { return !future.valid() || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+	VkResult wait() { return !future.valid() || future.get() ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED; }
+};
+
 class VkePipeline {
 	friend class VkeDevice;
 
 public:
+	static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4; // the maxBoundDescriptorSets every device supports
+
 	VkePipeline();
 
-	virtual void bind(VkCommandBuffer cmd) = 0;
+	virtual void bind(VkCommandBuffer cmd, std::span<const uint32_t> dynamicOffsets = {}) = 0;
 	void pushConstants(VkCommandBuffer cmd, GPUDrawPushConstants* constants,
 					   VkShaderStageFlags stage = VK_SHADER_STAGE_VERTEX_BIT);
 
 	VkePipeline& setDescriptorSet(VkeDescriptor& descriptorSet);
+	VkePipeline& setName(const std::string& name);
+
+	const VkeShaderReflection& getReflection() { return m_reflection; } // merged over the stages
+	bool usesShader(const VkeShader& shader);
+
+	// the pipeline or its fallback, main thread only: threads recording in parallel bind what it returned
+	VkPipeline resolve();
 
 protected:
+	virtual void buildKey(vkutil::HashKey& key) = 0; // every state that ends up in the VkPipeline
+	void applyReflection(); // push constant ranges unless set explicitly, warnings when the layout drifts from the shaders
+	virtual void updateShaderStages() = 0; // once the shader modules exist
+	void refreshShaders(); // hashes and reflection of m_shaders, after they were set or reloaded
+	void bindDescriptorSets(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, std::span<const uint32_t> dynamicOffsets);
+
 	VkPipeline m_pipeline;
 	VkPipelineLayout m_pipelineLayout;
 
 	VkPipelineLayoutCreateInfo m_pipelineLayoutInfo;
 
-	std::vector<VkDescriptorSetLayout*> m_descriptorLayouts;
-	std::vector<VkDescriptorSet*> m_descriptorSets;
+	std::string m_name; // only used for logging
+
+	std::vector<VkeDescriptor*> m_descriptors;
+	std::vector<VkPushConstantRange> m_pushConstantRanges;
+	bool m_explicitPushConstants{false}; // otherwise they follow the reflection
+	std::vector<VkeShader*> m_shaders;
+	std::vector<uint64_t> m_shaderHashes;
+	VkeShaderReflection m_reflection;
+
+	// registry keys of the pipeline and its layout, to release them
+	vkutil::HashKey m_key;
+	vkutil::HashKey m_layoutKey;
+
+	// while compiling, draws use the fallback which has to share the layout
+	std::shared_future<VkPipeline> m_pending;
+	VkPipeline m_fallback{VK_NULL_HANDLE};
 };
 
 class VkeGraphicsPipeline : public VkePipeline {
@@ -34,7 +74,8 @@ class VkeGraphicsPipeline : public VkePipeline {
 
 public:
 	VkeGraphicsPipeline();
-	void bind(VkCommandBuffer cmd) override;
+	void bind(VkCommandBuffer cmd, std::span<const uint32_t> dynamicOffsets = {}) override;
+	void bind(VkCommandBuffer cmd, VkPipeline pipeline, std::span<const uint32_t> dynamicOffsets); // already resolved
 
 	VkeGraphicsPipeline& setShaders(VkeShader& vertexShader, VkeShader& fragmentShader);
 	VkeGraphicsPipeline& setInputTopology(VkPrimitiveTopology topology);
@@ -51,6 +92,9 @@ public:
 	VkeGraphicsPipeline& setPushConstantRange(VkPushConstantRange& bufferRange, uint32_t count = 1);
 
 private:
+	void buildKey(vkutil::HashKey& key) override;
+	void updateShaderStages() override;
+
 	std::vector<VkPipelineShaderStageCreateInfo> m_shaderStages;
 	VkPipelineColorBlendAttachmentState m_colorBlendAttachment;
 	VkFormat m_colorAttachmentFormat;
@@ -66,11 +110,14 @@ class VkeComputePipeline : public VkePipeline {
 
 public:
 	VkeComputePipeline();
-	void bind(VkCommandBuffer cmd) override;
+	void bind(VkCommandBuffer cmd, std::span<const uint32_t> dynamicOffsets = {}) override;
 
 	VkeComputePipeline& setShader(VkeShader& computeShader);
 
 private:
+	void buildKey(vkutil::HashKey& key) override;
+	void updateShaderStages() override;
+
 	VkComputePipelineCreateInfo m_computeInfo;
 };
 
@@ -0,0 +1,97 @@
+#include "vke_range_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+using namespace vke;
+
+void VkeRangeAllocator::init(uint64_t capacity) {
+	m_capacity = capacity;
+	m_used = 0;
+	m_allocations = 0;
+
+	m_freeRanges.clear();
+	m_freeRanges[0] = capacity;
+}
+
+bool VkeRangeAllocator::allocate(uint64_t size, uint64_t* offset) {
+	if (size == 0)
+		return false;
+
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); it++) {
+		if (it->second < size)
+			continue;
+
+		*offset = it->first;
+
+		uint64_t remaining = it->second - size;
+		m_freeRanges.erase(it);
+
+		if (remaining > 0)
+			m_freeRanges[*offset + size] = remaining;
+
+		m_used += size;
+		m_allocations++;
+
+		return true;
+	}
+
+	return false;
+}
+
+void VkeRangeAllocator::free(uint64_t offset, uint64_t size) {
+	if (size == 0)
+		return;
+
+	assert(offset + size <= m_capacity);
+
+	m_used -= size;
+	m_allocations--;
+
+	auto next = m_freeRanges.lower_bound(offset);
+	assert(next == m_freeRanges.end() || next->first >= offset + size);
+
+	// merge with the following range
+	if (next != m_freeRanges.end() && next->first == offset + size) {
+		size += next->second;
+		next = m_freeRanges.erase(next);
+	}
+
+	// merge with the preceding range
+	if (next != m_freeRanges.begin()) {
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= offset);
+
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			size = 0;
+		}
+	}
+
+	if (size > 0)
+		m_freeRanges[offset] = size;
+}
+
+VkeRangeAllocator::Stats VkeRangeAllocator::getStats() const {
+	Stats stats = {
+		.capacity = m_capacity,
+		.used = m_used,
+		.largestFreeRange = 0,
+		.allocations = m_allocations,
+		.freeRanges = (uint32_t)m_freeRanges.size(),
+		.fragmentation = 0.0f,
+	};
+
+	uint64_t totalFree = 0;
+
+	for (auto& [offset, size] : m_freeRanges) {
+		totalFree += size;
+		stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+	}
+
+	if (totalFree > 0)
+		stats.fragmentation = 1.0f - (float)stats.largestFreeRange / (float)totalFree;
+
+	return stats;
+}
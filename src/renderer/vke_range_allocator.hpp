@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+namespace vke {
+
+// first-fit allocator over an abstract [0, capacity) range, used to sub-allocate the geometry arena
+class VkeRangeAllocator {
+public:
+	struct Stats {
+		uint64_t capacity;
+		uint64_t used;
+		uint64_t largestFreeRange;
+		uint32_t allocations;
+		uint32_t freeRanges;
+		float fragmentation; // 0 when all the free space is contiguous
+	};
+
+	VkeRangeAllocator(){};
+
+	void init(uint64_t capacity);
+
+	bool allocate(uint64_t size, uint64_t* offset);
+	void free(uint64_t offset, uint64_t size);
+
+	Stats getStats() const;
+
+private:
+	uint64_t m_capacity{0};
+	uint64_t m_used{0};
+	uint32_t m_allocations{0};
+
+	std::map<uint64_t, uint64_t> m_freeRanges; // offset -> size
+};
+
+} // namespace vke
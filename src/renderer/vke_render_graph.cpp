@@ -0,0 +1,602 @@
+#include "vke_render_graph.hpp"
+#include "vke_images.hpp"
+#include "vke_initializers.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace vke;
+
+struct UsageInfo {
+	VkPipelineStageFlags2 stages;
+	VkAccessFlags2 readAccess;
+	VkAccessFlags2 writeAccess;
+	VkImageLayout layout;
+	VkImageUsageFlags imageUsage;
+};
+
+// indexed by RenderGraphUsage
+static const UsageInfo USAGE_INFOS[] = {
+	{VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+	 VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT},
+	{VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+	 VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+	 VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT},
+	{VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE,
+	 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT},
+	{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE,
+	 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT},
+	{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+	 VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT},
+	{VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+	 VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT},
+	{VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	 VK_ACCESS_2_UNIFORM_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, 0},
+	{VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, 0},
+	{VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED,
+	 0},
+	{VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE,
+	 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT},
+	{VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+	 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT},
+	// the frame's signal semaphore has to come after the transition
+	{VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0},
+};
+
+static VkImageAspectFlags formatAspect(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::Pass::read(RenderGraphImage image, RenderGraphUsage usage) {
+	return use(image.index, true, false, usage);
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::Pass::write(RenderGraphImage image, RenderGraphUsage usage) {
+	return use(image.index, true, true, usage);
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::Pass::read(RenderGraphBuffer buffer, RenderGraphUsage usage) {
+	return use(buffer.index, false, false, usage);
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::Pass::write(RenderGraphBuffer buffer, RenderGraphUsage usage) {
+	return use(buffer.index, false, true, usage);
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::Pass::setExecute(std::function<void(VkCommandBuffer cmd)>&& execute) {
+	m_execute = std::move(execute);
+	return *this;
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::Pass::use(uint32_t resource, bool image, bool write, RenderGraphUsage usage) {
+	// reading and writing a resource the same way in one pass is a single access, not a dependency on itself
+	for (Access& access : m_accesses) {
+		if (access.resource == resource && access.image == image && access.usage == usage) {
+			access.write |= write;
+			return *this;
+		}
+	}
+
+	m_accesses.push_back({.resource = resource, .image = image, .write = write, .usage = usage});
+	return *this;
+}
+
+void VkeRenderGraph::init(VkDevice device, VmaAllocator allocator) {
+	m_device = device;
+	m_allocator = allocator;
+}
+
+void VkeRenderGraph::destroy() {
+	for (TransientImage& transient : m_transients) {
+		vkDestroyImageView(m_device, transient.image.imageView, nullptr);
+		vkDestroyImage(m_device, transient.image.image, nullptr);
+	}
+
+	for (MemoryBlock& block : m_blocks)
+		vmaFreeMemory(m_allocator, block.allocation);
+
+	m_transients.clear();
+	m_blocks.clear();
+	m_transientKey = {};
+
+	reset();
+}
+
+void VkeRenderGraph::reset() {
+	m_passes.clear();
+	m_images.clear();
+	m_buffers.clear();
+	m_culled.clear();
+	m_compiled.clear();
+}
+
+RenderGraphImage VkeRenderGraph::importImage(const std::string& name, VkeImage& image) {
+	// whatever any subresource still has pending is waited on, for the whole image
+	ResourceState state = {.layout = image.getState().layout, .visibleStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT};
+	for (const VkeSubresourceState& subresource : image.subresources) {
+		state.writeStages |= subresource.stages;
+		state.writeAccess |= subresource.access;
+		state.visibleStages &= subresource.visibleStages;
+	}
+
+	m_images.push_back({
+		.name = name,
+		.imported = &image,
+		.state = state,
+		.aspect = image.aspect,
+		.transient = UINT32_MAX,
+	});
+
+	return {(uint32_t)m_images.size() - 1};
+}
+
+RenderGraphImage VkeRenderGraph::importImage(const std::string& name, VkeImage& image, VkPipelineStageFlags2 lastStages,
+											 VkAccessFlags2 lastAccess) {
+	m_images.push_back({
+		.name = name,
+		.imported = &image,
+		.state = {.layout = image.getState().layout, .writeStages = lastStages, .writeAccess = lastAccess},
+		.aspect = image.aspect,
+		.transient = UINT32_MAX,
+	});
+
+	return {(uint32_t)m_images.size() - 1};
+}
+
+RenderGraphBuffer VkeRenderGraph::importBuffer(const std::string& name, VkBuffer buffer, VkPipelineStageFlags2 lastStages,
+											   VkAccessFlags2 lastAccess) {
+	m_buffers.push_back({
+		.name = name,
+		.buffer = buffer,
+		.state = {.writeStages = lastStages, .writeAccess = lastAccess},
+	});
+
+	return {(uint32_t)m_buffers.size() - 1};
+}
+
+RenderGraphImage VkeRenderGraph::createImage(const std::string& name, RenderGraphImageDesc desc) {
+	m_images.push_back({
+		.name = name,
+		.imported = nullptr,
+		.desc = desc,
+		.state = {.layout = VK_IMAGE_LAYOUT_UNDEFINED},
+		.aspect = formatAspect(desc.format),
+		.transient = UINT32_MAX,
+	});
+
+	return {(uint32_t)m_images.size() - 1};
+}
+
+void VkeRenderGraph::setFinalUsage(RenderGraphImage image, RenderGraphUsage usage) {
+	m_images[image.index].finalUsage = usage;
+}
+
+VkeRenderGraph::Pass& VkeRenderGraph::addPass(const std::string& name) {
+	Pass& pass = m_passes.emplace_back();
+	pass.m_name = name;
+
+	return pass;
+}
+
+VkeImage& VkeRenderGraph::getImage(RenderGraphImage image) {
+	ImageResource& resource = m_images[image.index];
+	return resource.imported ? *resource.imported : m_transients[resource.transient].image;
+}
+
+VkImage VkeRenderGraph::getVkImage(uint32_t resource) {
+	return getImage({resource}).image;
+}
+
+VkResult VkeRenderGraph::compile(vkutil::DeletionQueue& queue) {
+	cullPasses();
+
+	// lifetimes and usage only count the passes that survived
+	for (ImageResource& image : m_images) {
+		image.firstPass = UINT32_MAX;
+		image.lastPass = 0;
+		image.usage = 0;
+	}
+
+	for (uint32_t i = 0; i < m_passes.size(); i++) {
+		if (m_culled[i])
+			continue;
+
+		for (const Access& access : m_passes[i].m_accesses) {
+			if (!access.image)
+				continue;
+
+			ImageResource& image = m_images[access.resource];
+			image.firstPass = std::min(image.firstPass, i);
+			image.lastPass = std::max(image.lastPass, i);
+			image.usage |= USAGE_INFOS[(uint32_t)access.usage].imageUsage;
+		}
+	}
+
+	VK_RETURN(allocateTransients(queue));
+
+	m_compiled.clear();
+	m_stats = {.passes = (uint32_t)m_passes.size()};
+
+	std::vector<bool> started(m_images.size());
+
+	for (uint32_t i = 0; i < m_passes.size(); i++) {
+		if (m_culled[i]) {
+			m_stats.culledPasses++;
+			continue;
+		}
+
+		CompiledPass& compiled = m_compiled.emplace_back(CompiledPass{.pass = i});
+
+		for (const Access& access : m_passes[i].m_accesses) {
+			if (!access.image) {
+				BufferResource& buffer = m_buffers[access.resource];
+				addBarrier(compiled.barriers, access.resource, false, buffer.state, access.write, access.usage);
+				continue;
+			}
+
+			ImageResource& image = m_images[access.resource];
+			MemoryBlock* block = image.imported ? nullptr : &m_blocks[m_transients[image.transient].block];
+
+			// the first user of aliased memory waits for everything the previous image in it did, its contents are discarded
+			if (block && !started[access.resource]) {
+				image.state = {
+					.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+					.writeStages = block->state.writeStages | block->state.readStages,
+					.writeAccess = block->state.writeAccess,
+				};
+				started[access.resource] = true;
+			}
+
+			addBarrier(compiled.barriers, access.resource, true, image.state, access.write, access.usage);
+
+			if (block)
+				block->state = image.state;
+		}
+	}
+
+	CompiledPass final = {.pass = UINT32_MAX};
+	for (uint32_t i = 0; i < m_images.size(); i++) {
+		// a transient image nothing used was never created
+		bool exists = m_images[i].imported || m_images[i].firstPass != UINT32_MAX;
+		if (m_images[i].finalUsage && exists)
+			addBarrier(final.barriers, i, true, m_images[i].state, false, *m_images[i].finalUsage);
+	}
+
+	if (!final.barriers.empty())
+		m_compiled.push_back(std::move(final));
+
+	for (const CompiledPass& compiled : m_compiled) {
+		if (compiled.barriers.empty())
+			continue;
+
+		m_stats.barrierBatches++;
+		m_stats.barriers += compiled.barriers.size();
+	}
+
+	m_stats.transientImages = m_transients.size();
+	for (const TransientImage& transient : m_transients)
+		m_stats.transientBytes += transient.requirements.size;
+	for (const MemoryBlock& block : m_blocks)
+		m_stats.allocatedBytes += block.requirements.size;
+
+	return VK_SUCCESS;
+}
+
+void VkeRenderGraph::cullPasses() {
+	// imported resources outlive the frame, a transient one only matters if a surviving pass reads it
+	std::vector<bool> neededImages(m_images.size());
+	for (uint32_t i = 0; i < m_images.size(); i++)
+		neededImages[i] = m_images[i].imported != nullptr;
+
+	m_culled.assign(m_passes.size(), false);
+
+	for (uint32_t i = m_passes.size(); i-- > 0;) {
+		const Pass& pass = m_passes[i];
+
+		bool writes = false;
+		bool needed = false;
+		for (const Access& access : pass.m_accesses) {
+			if (!access.write)
+				continue;
+
+			writes = true;
+			needed |= !access.image || neededImages[access.resource];
+		}
+
+		// a pass that declares no writes has effects the graph cannot see, it is always kept
+		m_culled[i] = writes && !needed;
+		if (m_culled[i])
+			continue;
+
+		for (const Access& access : pass.m_accesses) {
+			if (access.image && !access.write)
+				neededImages[access.resource] = true;
+		}
+	}
+}
+
+void VkeRenderGraph::addBarrier(std::vector<Barrier>& barriers, uint32_t resource, bool image, ResourceState& state,
+								bool write, RenderGraphUsage usage) {
+	const UsageInfo& info = USAGE_INFOS[(uint32_t)usage];
+	VkAccessFlags2 access = write ? info.readAccess | info.writeAccess : info.readAccess;
+	bool transition = image && state.layout != info.layout;
+
+	Barrier barrier = {
+		.resource = resource,
+		.image = image,
+		.dstStages = info.stages,
+		.dstAccess = access,
+		.oldLayout = state.layout,
+		.newLayout = image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+
+	if (write || transition) {
+		// writes and layout changes wait for every earlier access, the earlier reads only need the execution dependency
+		barrier.srcStages = state.writeStages | state.readStages;
+		barrier.srcAccess = state.writeAccess;
+
+		if (barrier.srcStages || transition)
+			barriers.push_back(barrier);
+
+		if (write) {
+			state = {.writeStages = info.stages, .writeAccess = info.writeAccess};
+		} else {
+			state.readStages = info.stages;
+			state.visibleStages = info.stages;
+			state.visibleAccess = access;
+		}
+	} else if (state.writeStages && ((info.stages & ~state.visibleStages) || (access & ~state.visibleAccess))) {
+		// read after write, made visible once per stage and access however many passes read it
+		barrier.srcStages = state.writeStages;
+		barrier.srcAccess = state.writeAccess;
+		barriers.push_back(barrier);
+
+		state.readStages |= info.stages;
+		state.visibleStages |= info.stages;
+		state.visibleAccess |= access;
+	} else {
+		state.readStages |= info.stages;
+	}
+
+	if (image)
+		state.layout = info.layout;
+}
+
+VkResult VkeRenderGraph::allocateTransients(vkutil::DeletionQueue& queue) {
+	vkutil::HashKey key;
+	std::vector<uint32_t> transientImages;
+
+	for (uint32_t i = 0; i < m_images.size(); i++) {
+		const ImageResource& image = m_images[i];
+		if (image.imported || image.firstPass == UINT32_MAX)
+			continue;
+
+		key.add(image.desc, image.usage, image.firstPass, image.lastPass);
+		transientImages.push_back(i);
+	}
+
+	// the same declarations as the previous frame keep the same images and memory
+	if (key == m_transientKey) {
+		for (uint32_t i = 0; i < transientImages.size(); i++)
+			m_images[transientImages[i]].transient = i;
+
+		return VK_SUCCESS;
+	}
+
+	releaseTransients(queue);
+	m_transientKey = key;
+
+	for (uint32_t i : transientImages) {
+		ImageResource& image = m_images[i];
+		image.transient = m_transients.size();
+
+		TransientImage& transient = m_transients.emplace_back(TransientImage{
+			.desc = image.desc,
+			.usage = image.usage,
+			.firstPass = image.firstPass,
+			.lastPass = image.lastPass,
+			.block = UINT32_MAX,
+		});
+
+		VkImageCreateInfo imageInfo = vkinit::imageCreateInfo(image.desc.format, image.usage, image.desc.extent);
+		VK_RETURN(vkCreateImage(m_device, &imageInfo, nullptr, &transient.image.image));
+
+		vkGetImageMemoryRequirements(m_device, transient.image.image, &transient.requirements);
+	}
+
+	// largest first, each image goes in the first block whose images are all dead by the time it is used
+	std::vector<uint32_t> order(m_transients.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return m_transients[a].requirements.size > m_transients[b].requirements.size;
+	});
+
+	for (uint32_t index : order) {
+		TransientImage& transient = m_transients[index];
+
+		for (uint32_t b = 0; b < m_blocks.size() && transient.block == UINT32_MAX; b++) {
+			if (!(m_blocks[b].requirements.memoryTypeBits & transient.requirements.memoryTypeBits))
+				continue;
+
+			bool overlaps = std::any_of(m_transients.begin(), m_transients.end(), [&](const TransientImage& other) {
+				return other.block == b && other.firstPass <= transient.lastPass && transient.firstPass <= other.lastPass;
+			});
+
+			if (!overlaps)
+				transient.block = b;
+		}
+
+		if (transient.block == UINT32_MAX) {
+			transient.block = m_blocks.size();
+			m_blocks.push_back({.requirements = transient.requirements});
+			continue;
+		}
+
+		VkMemoryRequirements& requirements = m_blocks[transient.block].requirements;
+		requirements.size = std::max(requirements.size, transient.requirements.size);
+		requirements.alignment = std::max(requirements.alignment, transient.requirements.alignment);
+		requirements.memoryTypeBits &= transient.requirements.memoryTypeBits;
+	}
+
+	VmaAllocationCreateInfo allocInfo = {
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+		.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+	};
+
+	for (MemoryBlock& block : m_blocks)
+		VK_RETURN(vmaAllocateMemory(m_allocator, &block.requirements, &allocInfo, &block.allocation, nullptr));
+
+	for (TransientImage& transient : m_transients) {
+		VK_RETURN(vmaBindImageMemory(m_allocator, m_blocks[transient.block].allocation, transient.image.image));
+
+		VkImageViewCreateInfo viewInfo =
+			vkinit::imageViewCreateInfo(transient.desc.format, transient.image.image, formatAspect(transient.desc.format));
+		VK_RETURN(vkCreateImageView(m_device, &viewInfo, nullptr, &transient.image.imageView));
+	}
+
+	return VK_SUCCESS;
+}
+
+void VkeRenderGraph::releaseTransients(vkutil::DeletionQueue& queue) {
+	// the queue flushes in reverse, the images go before the memory they are bound to
+	for (MemoryBlock& block : m_blocks)
+		queue.pushAllocation(block.allocation);
+	for (TransientImage& transient : m_transients)
+		queue.pushImage(transient.image.image, transient.image.imageView, VK_NULL_HANDLE);
+
+	m_transients.clear();
+	m_blocks.clear();
+	m_transientKey = {};
+}
+
+void VkeRenderGraph::execute(VkCommandBuffer cmd) {
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+
+	for (const CompiledPass& compiled : m_compiled) {
+		imageBarriers.clear();
+		bufferBarriers.clear();
+
+		for (const Barrier& barrier : compiled.barriers) {
+			if (barrier.image) {
+				imageBarriers.push_back({
+					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+					.srcStageMask = barrier.srcStages,
+					.srcAccessMask = barrier.srcAccess,
+					.dstStageMask = barrier.dstStages,
+					.dstAccessMask = barrier.dstAccess,
+					.oldLayout = barrier.oldLayout,
+					.newLayout = barrier.newLayout,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.image = getVkImage(barrier.resource),
+					.subresourceRange = vkinit::imageSubResourceRange(m_images[barrier.resource].aspect),
+				});
+			} else {
+				bufferBarriers.push_back({
+					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+					.srcStageMask = barrier.srcStages,
+					.srcAccessMask = barrier.srcAccess,
+					.dstStageMask = barrier.dstStages,
+					.dstAccessMask = barrier.dstAccess,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.buffer = m_buffers[barrier.resource].buffer,
+					.offset = 0,
+					.size = VK_WHOLE_SIZE,
+				});
+			}
+		}
+
+		// every barrier of a pass in one call, the driver sees the whole batch at once
+		if (!imageBarriers.empty() || !bufferBarriers.empty()) {
+			VkDependencyInfo depInfo = {
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.bufferMemoryBarrierCount = (uint32_t)bufferBarriers.size(),
+				.pBufferMemoryBarriers = bufferBarriers.data(),
+				.imageMemoryBarrierCount = (uint32_t)imageBarriers.size(),
+				.pImageMemoryBarriers = imageBarriers.data(),
+			};
+
+			vkCmdPipelineBarrier2(cmd, &depInfo);
+		}
+
+		if (compiled.pass != UINT32_MAX && m_passes[compiled.pass].m_execute)
+			m_passes[compiled.pass].m_execute(cmd);
+	}
+
+	// imported images start the next frame from where the graph left them
+	for (ImageResource& image : m_images) {
+		if (!image.imported)
+			continue;
+
+		VkeSubresourceState state = {
+			.layout = image.state.layout,
+			.stages = image.state.writeStages | image.state.readStages,
+			.access = image.state.writeAccess,
+			.visibleStages = image.state.visibleStages,
+		};
+		vkutil::setImageState(*image.imported, state);
+	}
+}
+
+std::string VkeRenderGraph::dump() {
+	std::string text = fmt::format("render graph: {} passes, {} culled, {} barriers in {} batches\n", m_stats.passes,
+								   m_stats.culledPasses, m_stats.barriers, m_stats.barrierBatches);
+
+	auto dumpBarriers = [&](const CompiledPass& compiled) {
+		for (const Barrier& barrier : compiled.barriers) {
+			const std::string& name = barrier.image ? m_images[barrier.resource].name : m_buffers[barrier.resource].name;
+
+			text += fmt::format("    barrier {}: stages {:#x} -> {:#x}, access {:#x} -> {:#x}", name, barrier.srcStages,
+								barrier.dstStages, barrier.srcAccess, barrier.dstAccess);
+			if (barrier.image && barrier.oldLayout != barrier.newLayout) {
+				text += fmt::format(", {} -> {}", string_VkImageLayout(barrier.oldLayout),
+									string_VkImageLayout(barrier.newLayout));
+			}
+			text += "\n";
+		}
+	};
+
+	auto compiled = m_compiled.begin();
+	for (uint32_t i = 0; i < m_passes.size(); i++) {
+		if (m_culled[i]) {
+			text += fmt::format("  pass {} (culled)\n", m_passes[i].m_name);
+			continue;
+		}
+
+		text += fmt::format("  pass {}\n", m_passes[i].m_name);
+		dumpBarriers(*compiled++);
+	}
+
+	if (compiled != m_compiled.end()) {
+		text += "  final\n";
+		dumpBarriers(*compiled);
+	}
+
+	for (const ImageResource& image : m_images) {
+		if (image.imported || image.transient == UINT32_MAX)
+			continue;
+
+		const TransientImage& transient = m_transients[image.transient];
+		text += fmt::format("  transient {}: {}x{} {}, {} bytes in block {}, passes {}-{}\n", image.name, image.desc.extent.width,
+							image.desc.extent.height, string_VkFormat(image.desc.format), transient.requirements.size,
+							transient.block, transient.firstPass, transient.lastPass);
+	}
+
+	text += fmt::format("  transient memory: {} bytes allocated for {} bytes in {} images\n", m_stats.allocatedBytes,
+						m_stats.transientBytes, m_stats.transientImages);
+
+	return text;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "vke_types.hpp"
+#include "vke_utils.hpp"
+
+#include <deque>
+#include <optional>
+#include <string>
+
+namespace vke {
+
+// how a pass touches a resource, each maps to the stages, accesses and layout it needs
+enum class RenderGraphUsage : uint8_t {
+	ColorAttachment,
+	DepthAttachment,
+	FragmentSampled,
+	ComputeSampled,
+	ComputeStorage,
+	GraphicsStorage, // storage buffers read through device addresses in the vertex or fragment shader
+	Uniform,
+	IndexBuffer,
+	IndirectBuffer,
+	TransferSrc,
+	TransferDst,
+	Present,
+};
+
+struct RenderGraphImage {
+	uint32_t index{UINT32_MAX};
+};
+
+struct RenderGraphBuffer {
+	uint32_t index{UINT32_MAX};
+};
+
+struct RenderGraphImageDesc {
+	VkExtent3D extent;
+	VkFormat format;
+};
+
+// rebuilt every frame: passes declare what they read and write, compile derives the barriers, culls the passes nothing
+// depends on and places transient images with disjoint lifetimes in the same memory
+class VkeRenderGraph {
+	friend class VkeDevice;
+
+	struct Access {
+		uint32_t resource;
+		bool image;
+		bool write;
+		RenderGraphUsage usage;
+	};
+
+public:
+	struct Stats {
+		uint32_t passes;
+		uint32_t culledPasses;
+		uint32_t barriers;
+		uint32_t barrierBatches; // one vkCmdPipelineBarrier2 each
+		uint32_t transientImages;
+		VkDeviceSize transientBytes; // before aliasing
+		VkDeviceSize allocatedBytes;
+	};
+
+	class Pass {
+		friend class VkeRenderGraph;
+
+	public:
+		Pass& read(RenderGraphImage image, RenderGraphUsage usage);
+		Pass& write(RenderGraphImage image, RenderGraphUsage usage);
+		Pass& read(RenderGraphBuffer buffer, RenderGraphUsage usage);
+		Pass& write(RenderGraphBuffer buffer, RenderGraphUsage usage);
+		Pass& setExecute(std::function<void(VkCommandBuffer cmd)>&& execute);
+
+	private:
+		std::string m_name;
+		std::vector<Access> m_accesses;
+		std::function<void(VkCommandBuffer cmd)> m_execute;
+
+		Pass& use(uint32_t resource, bool image, bool write, RenderGraphUsage usage);
+	};
+
+	void reset(); // drops the passes and resources of the previous frame, transient memory is kept for reuse
+
+	// imported images are used as a whole, the first barrier starts from their tracked state and the final one is tracked
+	RenderGraphImage importImage(const std::string& name, VkeImage& image);
+	// for work the tracking did not see, like the presentation engine handing back a swapchain image
+	RenderGraphImage importImage(const std::string& name, VkeImage& image, VkPipelineStageFlags2 lastStages,
+								 VkAccessFlags2 lastAccess);
+	// state the buffer was left in by earlier work, the first barrier waits on it
+	RenderGraphBuffer importBuffer(const std::string& name, VkBuffer buffer,
+								   VkPipelineStageFlags2 lastStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+								   VkAccessFlags2 lastAccess = VK_ACCESS_2_MEMORY_WRITE_BIT);
+	RenderGraphImage createImage(const std::string& name, RenderGraphImageDesc desc); // transient, only valid this frame
+	void setFinalUsage(RenderGraphImage image, RenderGraphUsage usage); // transitioned after the last pass
+
+	Pass& addPass(const std::string& name);
+
+	VkeImage& getImage(RenderGraphImage image); // transient images only exist once compiled
+
+	VkResult compile(vkutil::DeletionQueue& queue); // replaced transient memory retires with the queue
+	void execute(VkCommandBuffer cmd);
+
+	std::string dump(); // compiled passes and their barriers as text
+	Stats getStats() { return m_stats; }
+
+private:
+	struct ResourceState {
+		VkImageLayout layout;
+		VkPipelineStageFlags2 writeStages; // last write, until a later write replaces it
+		VkAccessFlags2 writeAccess;
+		VkPipelineStageFlags2 readStages; // reads since the last write
+		VkPipelineStageFlags2 visibleStages; // the last write has been made visible to these
+		VkAccessFlags2 visibleAccess;
+	};
+
+	struct ImageResource {
+		std::string name;
+		VkeImage* imported;
+		RenderGraphImageDesc desc;
+		VkImageUsageFlags usage;
+		ResourceState state;
+		std::optional<RenderGraphUsage> finalUsage;
+		VkImageAspectFlags aspect;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		uint32_t transient; // index in m_transients
+	};
+
+	struct BufferResource {
+		std::string name;
+		VkBuffer buffer;
+		ResourceState state;
+	};
+
+	struct Barrier {
+		uint32_t resource;
+		bool image;
+		VkPipelineStageFlags2 srcStages;
+		VkAccessFlags2 srcAccess;
+		VkPipelineStageFlags2 dstStages;
+		VkAccessFlags2 dstAccess;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+	};
+
+	struct CompiledPass {
+		uint32_t pass; // UINT32_MAX for the final transitions
+		std::vector<Barrier> barriers;
+	};
+
+	// transient images survive across frames as long as the graph declares the same ones with the same lifetimes
+	struct TransientImage {
+		RenderGraphImageDesc desc;
+		VkImageUsageFlags usage;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		uint32_t block;
+		VkeImage image;
+		VkMemoryRequirements requirements;
+	};
+
+	struct MemoryBlock {
+		VmaAllocation allocation;
+		VkMemoryRequirements requirements;
+		ResourceState state; // of the last image placed in it, its first user waits on it
+	};
+
+	VkDevice m_device;
+	VmaAllocator m_allocator;
+
+	std::deque<Pass> m_passes; // stable, passes are configured through the references addPass returns
+	std::vector<ImageResource> m_images;
+	std::vector<BufferResource> m_buffers;
+
+	std::vector<bool> m_culled;
+	std::vector<CompiledPass> m_compiled;
+
+	vkutil::HashKey m_transientKey;
+	std::vector<TransientImage> m_transients;
+	std::vector<MemoryBlock> m_blocks;
+
+	Stats m_stats{};
+
+	void init(VkDevice device, VmaAllocator allocator);
+	void destroy();
+
+	void cullPasses();
+	VkResult allocateTransients(vkutil::DeletionQueue& queue);
+	void releaseTransients(vkutil::DeletionQueue& queue);
+	void addBarrier(std::vector<Barrier>& barriers, uint32_t resource, bool image, ResourceState& state, bool write,
+					RenderGraphUsage usage);
+	VkImage getVkImage(uint32_t resource);
+};
+
+} // namespace vke
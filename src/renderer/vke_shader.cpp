@@ -1,21 +1,40 @@
 #include "vke_shader.hpp"
+#include "vke_utils.hpp"
 #include <fstream>
 
 using namespace vke;
 
-VkResult VkeShader::loadShaderModule(const char* filePath, std::vector<uint32_t>& buffer) {
-	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+VkResult VkeShader::loadShaderModule(const char* filePath) {
+	VK_RETURN(vkutil::readSpirv(filePath, &m_code));
+
+	m_hash = vkutil::hashBytes(m_code.data(), m_code.size() * sizeof(uint32_t));
+	m_mappedCode = {};
+	m_verified = true;
+
+	// reflected once per SPIR-V, later runs read it back from next to the .spv
+	std::string reflectionPath = std::string(filePath) + ".refl";
+	if (!vkutil::loadReflection(reflectionPath, m_hash, &m_reflection)) {
+		m_reflection = {};
+		VK_RETURN(vkutil::reflectShader(m_code, &m_reflection));
+		vkutil::saveReflection(reflectionPath, m_hash, m_reflection);
+	}
+
+	return VK_SUCCESS;
+}
+
+VkResult vkutil::readSpirv(const char* path, std::vector<uint32_t>* code) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
 
 	if (!file.is_open())
 		return VK_ERROR_INITIALIZATION_FAILED;
 
 	size_t fileSize = (size_t)file.tellg();
 
-	buffer.resize(fileSize / sizeof(uint32_t));
+	code->resize(fileSize / sizeof(uint32_t));
 
 	file.seekg(0);
 
-	file.read((char*)buffer.data(), fileSize);
+	file.read((char*)code->data(), fileSize);
 
 	file.close();
 
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "vke_shader_reflection.hpp"
 #include "vke_types.hpp"
 
 namespace vke {
 
 class VkeShader {
 	friend class VkeDevice;
+	friend class VkeShaderArchive;
 
 public:
 	enum ShaderType {
@@ -16,13 +18,28 @@ public:
 
 	VkeShader() {}
 
-	const VkShaderModule& getModule() { return m_shaderModule; }
+	const VkShaderModule& getModule() { return m_shaderModule; } // VK_NULL_HANDLE until a pipeline compiles with it
+	uint64_t getHash() { return m_hash; } // of the SPIR-V, identifies the shader across modules
+	const VkeShaderReflection& getReflection() { return m_reflection; }
+	std::span<const uint32_t> getCode() { return m_mappedCode.empty() ? m_code : m_mappedCode; }
+	const std::string& getPath() { return m_path; }
 
 private:
-	VkShaderModule m_shaderModule;
-	const char* m_name;
+	VkShaderModule m_shaderModule{VK_NULL_HANDLE};
+	uint64_t m_hash;
+	VkeShaderReflection m_reflection;
+	std::string m_path; // as given to createShader
 
-	VkResult loadShaderModule(const char* filePath, std::vector<uint32_t>& buffer);
+	// loose files own their code, archived shaders point into the mapping which has to outlive them
+	std::vector<uint32_t> m_code;
+	std::span<const uint32_t> m_mappedCode;
+	bool m_verified{false}; // code checked against m_hash
+
+	VkResult loadShaderModule(const char* filePath);
 };
 
 } // namespace vke
+
+namespace vkutil {
+VkResult readSpirv(const char* path, std::vector<uint32_t>* code);
+}
@@ -0,0 +1,174 @@
+#include "vke_shader_archive.hpp"
+#include "vke_utils.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace vke;
+
+VkResult VkeShaderArchive::open(const char* path) {
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ShaderArchiveHeader)) {
+		::close(fd);
+		return VK_ERROR_INITIALIZATION_FAILED;
+	}
+
+	// pages are only read once a shader is used, the mapping stays valid after the descriptor is closed
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	m_data = (const uint8_t*)data;
+	m_size = (size_t)info.st_size;
+
+	const ShaderArchiveHeader* header = (const ShaderArchiveHeader*)m_data;
+	size_t tableSize = (size_t)header->shaderCount * sizeof(ShaderArchiveEntry);
+
+	if (header->magic != SHADER_ARCHIVE_MAGIC || header->version != SHADER_ARCHIVE_VERSION ||
+		tableSize > m_size - sizeof(ShaderArchiveHeader) ||
+		vkutil::hashBytes(m_data + sizeof(ShaderArchiveHeader), tableSize) != header->tableChecksum) {
+		close();
+		return VK_ERROR_INITIALIZATION_FAILED;
+	}
+
+	m_entries = {(const ShaderArchiveEntry*)(m_data + sizeof(ShaderArchiveHeader)), header->shaderCount};
+
+	for (uint32_t i = 0; i < m_entries.size(); i++) {
+		if (!isValid(m_entries[i])) {
+			close();
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
+
+		m_byName[std::string_view(m_entries[i].name)] = i;
+		m_byHash[m_entries[i].hash] = i;
+	}
+
+	return VK_SUCCESS;
+}
+
+void VkeShaderArchive::close() {
+	if (m_data)
+		munmap((void*)m_data, m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_entries = {};
+	m_byName.clear();
+	m_byHash.clear();
+}
+
+bool VkeShaderArchive::isValid(const ShaderArchiveEntry& entry) {
+	size_t bindingsSize = (size_t)entry.bindingCount * sizeof(VkeShaderReflection::Binding);
+
+	return memchr(entry.name, '\0', SHADER_ARCHIVE_NAME_SIZE) != nullptr && entry.codeOffset % sizeof(uint32_t) == 0 &&
+		   entry.codeSize % sizeof(uint32_t) == 0 && entry.codeOffset <= m_size && entry.codeSize <= m_size - entry.codeOffset &&
+		   entry.bindingsOffset % alignof(VkeShaderReflection::Binding) == 0 && entry.bindingsOffset <= m_size &&
+		   bindingsSize <= m_size - entry.bindingsOffset;
+}
+
+const ShaderArchiveEntry* VkeShaderArchive::find(std::string_view name) {
+	auto it = m_byName.find(name);
+	return it == m_byName.end() ? nullptr : &m_entries[it->second];
+}
+
+const ShaderArchiveEntry* VkeShaderArchive::find(uint64_t hash) {
+	auto it = m_byHash.find(hash);
+	return it == m_byHash.end() ? nullptr : &m_entries[it->second];
+}
+
+VkResult VkeShaderArchive::getShader(const ShaderArchiveEntry& entry, VkeShader* shader) {
+	shader->m_hash = entry.hash;
+	shader->m_code.clear();
+	shader->m_mappedCode = {(const uint32_t*)(m_data + entry.codeOffset), entry.codeSize / sizeof(uint32_t)};
+	shader->m_verified = false;
+
+	const VkeShaderReflection::Binding* bindings = (const VkeShaderReflection::Binding*)(m_data + entry.bindingsOffset);
+
+	shader->m_reflection = {
+		.stages = entry.stages,
+		.bindings = {bindings, bindings + entry.bindingCount},
+		.pushConstantSize = entry.pushConstantSize,
+		.pushConstantStages = entry.pushConstantStages,
+		.localSize = {entry.localSize[0], entry.localSize[1], entry.localSize[2]},
+	};
+
+	return VK_SUCCESS;
+}
+
+VkResult vkutil::writeShaderArchive(const std::string& path, std::span<const std::string> spirvPaths) {
+	std::vector<ShaderArchiveEntry> entries(spirvPaths.size());
+	std::vector<uint8_t> blobs;
+
+	size_t dataOffset = sizeof(ShaderArchiveHeader) + entries.size() * sizeof(ShaderArchiveEntry);
+
+	for (size_t i = 0; i < spirvPaths.size(); i++) {
+		std::vector<uint32_t> code;
+		VK_RETURN(readSpirv(spirvPaths[i].c_str(), &code));
+
+		VkeShaderReflection reflection;
+		VK_RETURN(reflectShader(code, &reflection));
+
+		std::string name = std::filesystem::path(spirvPaths[i]).filename().string();
+		if (name.size() >= SHADER_ARCHIVE_NAME_SIZE)
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		ShaderArchiveEntry& entry = entries[i];
+		entry = {
+			.hash = hashBytes(code.data(), code.size() * sizeof(uint32_t)),
+			.codeOffset = dataOffset + blobs.size(),
+			.codeSize = code.size() * sizeof(uint32_t),
+			.bindingCount = (uint32_t)reflection.bindings.size(),
+			.stages = reflection.stages,
+			.pushConstantSize = reflection.pushConstantSize,
+			.pushConstantStages = reflection.pushConstantStages,
+			.localSize = {reflection.localSize[0], reflection.localSize[1], reflection.localSize[2]},
+		};
+		memcpy(entry.name, name.c_str(), name.size() + 1);
+
+		// both blobs are made of 4 byte words, so every offset stays aligned
+		blobs.insert(blobs.end(), (const uint8_t*)code.data(), (const uint8_t*)(code.data() + code.size()));
+
+		entry.bindingsOffset = dataOffset + blobs.size();
+		blobs.insert(blobs.end(), (const uint8_t*)reflection.bindings.data(),
+					 (const uint8_t*)(reflection.bindings.data() + reflection.bindings.size()));
+	}
+
+	ShaderArchiveHeader header = {
+		.magic = SHADER_ARCHIVE_MAGIC,
+		.version = SHADER_ARCHIVE_VERSION,
+		.shaderCount = (uint32_t)entries.size(),
+		.tableChecksum = hashBytes(entries.data(), entries.size() * sizeof(ShaderArchiveEntry)),
+	};
+
+	// same as the pipeline cache, a failed write never replaces a good archive
+	std::string tmpPath = path + ".tmp";
+
+	std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)entries.data(), entries.size() * sizeof(ShaderArchiveEntry));
+	file.write((const char*)blobs.data(), blobs.size());
+	file.close();
+
+	if (file.fail())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+
+	return error ? VK_ERROR_INITIALIZATION_FAILED : VK_SUCCESS;
+}
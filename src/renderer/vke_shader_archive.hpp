@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vke_shader.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace vke {
+
+constexpr uint32_t SHADER_ARCHIVE_MAGIC = 0x41534B56; // "VKSA"
+constexpr uint32_t SHADER_ARCHIVE_VERSION = 1;
+constexpr uint32_t SHADER_ARCHIVE_NAME_SIZE = 64;
+
+struct ShaderArchiveHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t shaderCount;
+	uint32_t padding;
+	uint64_t tableChecksum; // of the entry table, the code of a shader is only checked when its module is created
+};
+
+// offsets are from the start of the file, code is 4 byte aligned so it is handed to vkCreateShaderModule in place
+struct ShaderArchiveEntry {
+	char name[SHADER_ARCHIVE_NAME_SIZE]; // file name of the .spv, null terminated
+	uint64_t hash;						 // of the SPIR-V
+	uint64_t codeOffset;
+	uint64_t codeSize;
+	uint64_t bindingsOffset;
+	uint32_t bindingCount;
+	uint32_t stages;
+	uint32_t pushConstantSize;
+	uint32_t pushConstantStages;
+	uint32_t localSize[3];
+	uint32_t padding;
+};
+
+// compiled shaders packed in one file and mapped read-only, shaders point into the mapping instead of copying their code
+class VkeShaderArchive {
+public:
+	VkResult open(const char* path);
+	void close();
+
+	bool isOpen() { return m_data != nullptr; }
+	uint32_t getShaderCount() { return (uint32_t)m_entries.size(); }
+
+	const ShaderArchiveEntry* find(std::string_view name);
+	const ShaderArchiveEntry* find(uint64_t hash);
+	VkResult getShader(const ShaderArchiveEntry& entry, VkeShader* shader);
+
+private:
+	const uint8_t* m_data{nullptr};
+	size_t m_size{0};
+
+	std::span<const ShaderArchiveEntry> m_entries;
+	std::unordered_map<std::string_view, uint32_t> m_byName;
+	std::unordered_map<uint64_t, uint32_t> m_byHash;
+
+	bool isValid(const ShaderArchiveEntry& entry);
+};
+
+} // namespace vke
+
+namespace vkutil {
+// packs the shaders under their file names, reflected at pack time so loading them never parses SPIR-V
+VkResult writeShaderArchive(const std::string& path, std::span<const std::string> spirvPaths);
+} // namespace vkutil
@@ -0,0 +1,456 @@
+#include "vke_shader_reflection.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using namespace vke;
+
+namespace {
+
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr uint32_t REFLECTION_MAGIC = 0x52454B56; // "VKER"
+constexpr uint32_t REFLECTION_VERSION = 1;
+
+enum SpirvOp : uint16_t {
+	OpEntryPoint = 15,
+	OpExecutionMode = 16,
+	OpTypeBool = 20,
+	OpTypeInt = 21,
+	OpTypeFloat = 22,
+	OpTypeVector = 23,
+	OpTypeMatrix = 24,
+	OpTypeImage = 25,
+	OpTypeSampler = 26,
+	OpTypeSampledImage = 27,
+	OpTypeArray = 28,
+	OpTypeRuntimeArray = 29,
+	OpTypeStruct = 30,
+	OpTypePointer = 32,
+	OpConstant = 43,
+	OpVariable = 59,
+	OpDecorate = 71,
+	OpMemberDecorate = 72,
+};
+
+enum SpirvDecoration : uint32_t {
+	DecorationBlock = 2,
+	DecorationBufferBlock = 3,
+	DecorationArrayStride = 6,
+	DecorationMatrixStride = 7,
+	DecorationBinding = 33,
+	DecorationDescriptorSet = 34,
+	DecorationOffset = 35,
+};
+
+enum SpirvStorageClass : uint32_t {
+	StorageClassUniformConstant = 0,
+	StorageClassUniform = 2,
+	StorageClassPushConstant = 9,
+	StorageClassStorageBuffer = 12,
+};
+
+constexpr uint32_t ExecutionModeLocalSize = 17;
+constexpr uint32_t DimBuffer = 5;
+
+// everything the reflection needs to know about a result id
+struct SpirvId {
+	uint16_t opcode{0};
+	std::vector<uint32_t> operands; // of the defining instruction, after the result id
+
+	uint32_t set{UINT32_MAX};
+	uint32_t binding{UINT32_MAX};
+	uint32_t arrayStride{0};
+	bool block{false};
+	bool bufferBlock{false};
+
+	std::vector<uint32_t> memberOffsets;
+	std::vector<uint32_t> memberMatrixStrides;
+};
+
+VkShaderStageFlagBits executionModelStage(uint32_t model) {
+	switch (model) {
+	case 0:
+		return VK_SHADER_STAGE_VERTEX_BIT;
+	case 1:
+		return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+	case 2:
+		return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	case 3:
+		return VK_SHADER_STAGE_GEOMETRY_BIT;
+	case 4:
+		return VK_SHADER_STAGE_FRAGMENT_BIT;
+	case 5:
+		return VK_SHADER_STAGE_COMPUTE_BIT;
+	default:
+		return VK_SHADER_STAGE_ALL;
+	}
+}
+
+uint32_t typeSize(const std::vector<SpirvId>& ids, uint32_t id, uint32_t matrixStride = 0) {
+	const SpirvId& type = ids[id];
+
+	switch (type.opcode) {
+	case OpTypeBool:
+		return 4;
+	case OpTypeInt:
+	case OpTypeFloat:
+		return type.operands[0] / 8;
+	case OpTypeVector:
+		return type.operands[1] * typeSize(ids, type.operands[0]);
+	case OpTypeMatrix:
+		return type.operands[1] * (matrixStride ? matrixStride : typeSize(ids, type.operands[0]));
+	case OpTypeArray: {
+		const SpirvId& length = ids[type.operands[1]];
+		if (length.opcode != OpConstant)
+			return 0;
+
+		return length.operands[1] * (type.arrayStride ? type.arrayStride : typeSize(ids, type.operands[0]));
+	}
+	case OpTypePointer:
+		return 8; // physical storage buffer address
+	case OpTypeStruct: {
+		uint32_t size = 0;
+		for (size_t i = 0; i < type.operands.size(); i++) {
+			uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+			uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+			size = std::max(size, offset + typeSize(ids, type.operands[i], stride));
+		}
+		return size;
+	}
+	default:
+		return 0; // runtime arrays
+	}
+}
+
+// fewest words of the instructions the reflection reads, so every operand it looks at is there
+uint32_t minWordCount(uint16_t opcode) {
+	switch (opcode) {
+	case OpEntryPoint:
+	case OpTypeBool:
+	case OpTypeSampler:
+		return 2;
+	case OpExecutionMode:
+	case OpDecorate:
+	case OpTypeInt:
+	case OpTypeFloat:
+	case OpTypeSampledImage:
+	case OpTypeRuntimeArray:
+	case OpTypeStruct:
+	case OpConstant:
+		return 3;
+	case OpTypeVector:
+	case OpTypeMatrix:
+	case OpTypeArray:
+	case OpTypePointer:
+	case OpVariable:
+		return 4;
+	case OpMemberDecorate:
+		return 5;
+	case OpTypeImage:
+		return 9;
+	default:
+		return 1;
+	}
+}
+
+// operands of the types that name other ids, they are followed once the whole module is parsed; only pointers may
+// name a type declared later, so typeSize cannot recurse through a cycle
+bool typeIdsValid(uint16_t opcode, const uint32_t* words, uint32_t wordCount, const std::vector<SpirvId>& ids) {
+	auto defined = [&](uint32_t first, uint32_t last) {
+		return std::all_of(words + first, words + last, [&](uint32_t id) { return id < ids.size() && ids[id].opcode != 0; });
+	};
+
+	switch (opcode) {
+	case OpTypeVector:
+	case OpTypeMatrix:
+	case OpTypeSampledImage:
+	case OpTypeRuntimeArray:
+		return defined(2, 3);
+	case OpTypeArray:
+		return defined(2, 4);
+	case OpTypeStruct:
+		return defined(2, wordCount);
+	case OpTypePointer:
+		return words[3] < ids.size();
+	default:
+		return true;
+	}
+}
+
+bool descriptorType(uint32_t storageClass, const SpirvId& type, VkDescriptorType* result) {
+	switch (type.opcode) {
+	case OpTypeImage: {
+		bool storage = type.operands[5] == 2;
+		if (type.operands[1] == DimBuffer)
+			*result = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+		else
+			*result = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		return true;
+	}
+	case OpTypeSampler:
+		*result = VK_DESCRIPTOR_TYPE_SAMPLER;
+		return true;
+	case OpTypeSampledImage:
+		*result = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		return true;
+	case OpTypeStruct:
+		// before SPIR-V 1.3 storage buffers are uniform blocks decorated with BufferBlock
+		if (storageClass == StorageClassStorageBuffer || type.bufferBlock)
+			*result = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		else
+			*result = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		return true;
+	default:
+		return false;
+	}
+}
+
+} // namespace
+
+void VkeShaderReflection::merge(const VkeShaderReflection& other) {
+	stages |= other.stages;
+
+	for (const Binding& binding : other.bindings) {
+		auto it = std::find_if(bindings.begin(), bindings.end(),
+							   [&](const Binding& b) { return b.set == binding.set && b.binding == binding.binding; });
+
+		if (it == bindings.end()) {
+			bindings.push_back(binding);
+			continue;
+		}
+
+		if (it->type != binding.type)
+			fmt::println("Shader stages disagree on the type of set {} binding {}", binding.set, binding.binding);
+
+		it->stages |= binding.stages;
+		it->count = std::max(it->count, binding.count);
+	}
+
+	pushConstantSize = std::max(pushConstantSize, other.pushConstantSize);
+	pushConstantStages |= other.pushConstantStages;
+
+	if (other.stages & VK_SHADER_STAGE_COMPUTE_BIT)
+		std::copy(other.localSize, other.localSize + 3, localSize);
+}
+
+std::vector<VkeShaderReflection::Binding> VkeShaderReflection::getSetBindings(uint32_t set) const {
+	std::vector<Binding> result;
+	std::copy_if(bindings.begin(), bindings.end(), std::back_inserter(result), [set](const Binding& b) { return b.set == set; });
+	return result;
+}
+
+VkResult vkutil::reflectShader(std::span<const uint32_t> code, VkeShaderReflection* reflection) {
+	if (code.size() < 5 || code[0] != SPIRV_MAGIC)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	// every id is defined by an instruction of at least two words, a larger bound is a corrupt header
+	uint32_t bound = code[3];
+	if (bound > code.size())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	std::vector<SpirvId> ids(bound);
+	std::vector<uint32_t> variables;
+	VkShaderStageFlags stage = 0;
+
+	for (size_t i = 5; i < code.size();) {
+		uint16_t opcode = code[i] & 0xFFFF;
+		uint32_t wordCount = code[i] >> 16;
+
+		if (wordCount == 0 || i + wordCount > code.size())
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		const uint32_t* words = &code[i];
+
+		if (wordCount < minWordCount(opcode) || !typeIdsValid(opcode, words, wordCount, ids))
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		// the result id, or the target of a decoration; OpConstant and OpVariable also name their result type
+		bool hasResult = opcode == OpDecorate || opcode == OpMemberDecorate || (opcode >= OpTypeBool && opcode <= OpTypePointer);
+		bool hasTypedResult = opcode == OpConstant || opcode == OpVariable;
+
+		if ((hasResult && words[1] >= bound) || (hasTypedResult && (words[1] >= bound || words[2] >= bound)))
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		switch (opcode) {
+		case OpEntryPoint:
+			if (!stage)
+				stage = executionModelStage(words[1]);
+			break;
+		case OpExecutionMode:
+			if (words[2] == ExecutionModeLocalSize && wordCount >= 6)
+				std::copy(words + 3, words + 6, reflection->localSize);
+			break;
+		case OpDecorate: {
+			SpirvId& target = ids[words[1]];
+			uint32_t value = wordCount > 3 ? words[3] : 0;
+
+			if (words[2] == DecorationBlock)
+				target.block = true;
+			else if (words[2] == DecorationBufferBlock)
+				target.bufferBlock = true;
+			else if (words[2] == DecorationArrayStride)
+				target.arrayStride = value;
+			else if (words[2] == DecorationDescriptorSet)
+				target.set = value;
+			else if (words[2] == DecorationBinding)
+				target.binding = value;
+			break;
+		}
+		case OpMemberDecorate: {
+			SpirvId& target = ids[words[1]];
+			uint32_t member = words[2];
+
+			// a struct cannot have more members than the module has words
+			if (member >= code.size())
+				return VK_ERROR_INITIALIZATION_FAILED;
+
+			if (words[3] == DecorationOffset) {
+				target.memberOffsets.resize(std::max<size_t>(target.memberOffsets.size(), member + 1));
+				target.memberOffsets[member] = words[4];
+			} else if (words[3] == DecorationMatrixStride) {
+				target.memberMatrixStrides.resize(std::max<size_t>(target.memberMatrixStrides.size(), member + 1));
+				target.memberMatrixStrides[member] = words[4];
+			}
+			break;
+		}
+		case OpTypeBool:
+		case OpTypeInt:
+		case OpTypeFloat:
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeImage:
+		case OpTypeSampler:
+		case OpTypeSampledImage:
+		case OpTypeArray:
+		case OpTypeRuntimeArray:
+		case OpTypeStruct:
+		case OpTypePointer:
+			ids[words[1]].opcode = opcode;
+			ids[words[1]].operands.assign(words + 2, words + wordCount);
+			break;
+		case OpConstant:
+		case OpVariable:
+			// result type first, then the result id
+			ids[words[2]].opcode = opcode;
+			ids[words[2]].operands.assign({words[1], wordCount > 3 ? words[3] : 0});
+
+			if (opcode == OpVariable)
+				variables.push_back(words[2]);
+			break;
+		}
+
+		i += wordCount;
+	}
+
+	reflection->stages = stage;
+
+	for (uint32_t id : variables) {
+		const SpirvId& variable = ids[id];
+		const SpirvId& pointer = ids[variable.operands[0]];
+		uint32_t storageClass = variable.operands[1];
+
+		if (pointer.opcode != OpTypePointer)
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		uint32_t typeId = pointer.operands[1];
+
+		if (storageClass == StorageClassPushConstant) {
+			reflection->pushConstantSize = std::max(reflection->pushConstantSize, typeSize(ids, typeId));
+			reflection->pushConstantStages |= stage;
+			continue;
+		}
+
+		if (storageClass != StorageClassUniformConstant && storageClass != StorageClassUniform &&
+			storageClass != StorageClassStorageBuffer)
+			continue;
+
+		if (variable.set == UINT32_MAX || variable.binding == UINT32_MAX)
+			continue;
+
+		uint32_t count = 1;
+		if (ids[typeId].opcode == OpTypeArray) {
+			const SpirvId& length = ids[ids[typeId].operands[1]];
+			count = length.opcode == OpConstant ? length.operands[1] : 1;
+			typeId = ids[typeId].operands[0];
+		} else if (ids[typeId].opcode == OpTypeRuntimeArray) {
+			count = 0;
+			typeId = ids[typeId].operands[0];
+		}
+
+		VkDescriptorType type;
+		if (!descriptorType(storageClass, ids[typeId], &type))
+			continue;
+
+		reflection->bindings.push_back({
+			.set = variable.set,
+			.binding = variable.binding,
+			.type = type,
+			.count = count,
+			.stages = stage,
+		});
+	}
+
+	return VK_SUCCESS;
+}
+
+struct ReflectionHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t spirvHash;
+	uint32_t stages;
+	uint32_t pushConstantSize;
+	uint32_t pushConstantStages;
+	uint32_t localSize[3];
+	uint32_t bindingCount;
+	uint32_t padding;
+};
+
+bool vkutil::loadReflection(const std::string& path, uint64_t spirvHash, VkeShaderReflection* reflection) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+		return false;
+
+	size_t fileSize = (size_t)file.tellg();
+	file.seekg(0);
+
+	ReflectionHeader header;
+	file.read((char*)&header, sizeof(header));
+
+	if (!file || header.magic != REFLECTION_MAGIC || header.version != REFLECTION_VERSION || header.spirvHash != spirvHash)
+		return false;
+
+	// a truncated or corrupt file must not size the bindings, the caller reparses the shader instead
+	if (header.bindingCount != (fileSize - sizeof(header)) / sizeof(VkeShaderReflection::Binding) ||
+		(fileSize - sizeof(header)) % sizeof(VkeShaderReflection::Binding) != 0)
+		return false;
+
+	reflection->stages = header.stages;
+	reflection->pushConstantSize = header.pushConstantSize;
+	reflection->pushConstantStages = header.pushConstantStages;
+	std::copy(header.localSize, header.localSize + 3, reflection->localSize);
+
+	reflection->bindings.resize(header.bindingCount);
+	file.read((char*)reflection->bindings.data(), header.bindingCount * sizeof(VkeShaderReflection::Binding));
+
+	return (bool)file;
+}
+
+void vkutil::saveReflection(const std::string& path, uint64_t spirvHash, const VkeShaderReflection& reflection) {
+	ReflectionHeader header = {
+		.magic = REFLECTION_MAGIC,
+		.version = REFLECTION_VERSION,
+		.spirvHash = spirvHash,
+		.stages = reflection.stages,
+		.pushConstantSize = reflection.pushConstantSize,
+		.pushConstantStages = reflection.pushConstantStages,
+		.localSize = {reflection.localSize[0], reflection.localSize[1], reflection.localSize[2]},
+		.bindingCount = (uint32_t)reflection.bindings.size(),
+	};
+
+	// a missing cache only costs a reflection pass on the next run, write errors are ignored
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)reflection.bindings.data(), reflection.bindings.size() * sizeof(VkeShaderReflection::Binding));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "vke_types.hpp"
+
+namespace vke {
+
+// resources a shader (or every stage of a pipeline, once merged) declares in its SPIR-V
+struct VkeShaderReflection {
+	struct Binding {
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count; // 0 for runtime arrays
+		VkShaderStageFlags stages;
+	};
+
+	VkShaderStageFlags stages{0};
+	std::vector<Binding> bindings;
+
+	uint32_t pushConstantSize{0};
+	VkShaderStageFlags pushConstantStages{0};
+
+	uint32_t localSize[3]{1, 1, 1}; // compute only
+
+	void merge(const VkeShaderReflection& other);
+	std::vector<Binding> getSetBindings(uint32_t set) const;
+};
+
+} // namespace vke
+
+namespace vkutil {
+VkResult reflectShader(std::span<const uint32_t> code, vke::VkeShaderReflection* reflection);
+
+// cached next to the SPIR-V, only reused while the hash of the SPIR-V matches
+bool loadReflection(const std::string& path, uint64_t spirvHash, vke::VkeShaderReflection* reflection);
+void saveReflection(const std::string& path, uint64_t spirvHash, const vke::VkeShaderReflection& reflection);
+} // namespace vkutil
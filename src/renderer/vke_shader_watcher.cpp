@@ -0,0 +1,116 @@
+#include "vke_shader_watcher.hpp"
+
+#include <filesystem>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using namespace vke;
+
+constexpr int WATCH_POLL_MS = 100; // how long destroy waits for the watcher thread at most
+
+static bool isShaderStage(const std::filesystem::path& path) {
+	std::string extension = path.extension().string();
+	return extension == ".vert" || extension == ".frag" || extension == ".comp";
+}
+
+VkResult VkeShaderWatcher::init(const char* sourceDir, const char* outputDir) {
+	m_sourceDir = sourceDir;
+	m_outputDir = outputDir;
+
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	// editors either write in place or rename a temporary file over the source
+	if (inotify_add_watch(m_inotify, sourceDir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(m_inotify);
+		m_inotify = -1;
+		return VK_ERROR_INITIALIZATION_FAILED;
+	}
+
+	m_stopping = false;
+	m_thread = std::thread(&VkeShaderWatcher::watchLoop, this);
+
+	return VK_SUCCESS;
+}
+
+void VkeShaderWatcher::destroy() {
+	if (m_inotify < 0)
+		return;
+
+	m_stopping = true;
+	m_thread.join();
+
+	close(m_inotify);
+	m_inotify = -1;
+}
+
+std::vector<std::string> VkeShaderWatcher::takeCompiledShaders() {
+	std::lock_guard lock(m_mutex);
+
+	std::vector<std::string> compiled(m_compiled.begin(), m_compiled.end());
+	m_compiled.clear();
+
+	return compiled;
+}
+
+void VkeShaderWatcher::watchLoop() {
+	alignas(inotify_event) char buffer[4096];
+
+	while (!m_stopping) {
+		pollfd fd = {.fd = m_inotify, .events = POLLIN};
+		if (poll(&fd, 1, WATCH_POLL_MS) <= 0)
+			continue;
+
+		// a save usually comes as several events, they are gathered so each file compiles once
+		std::set<std::string> changed;
+		ssize_t length;
+
+		while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+			for (char* ptr = buffer; ptr < buffer + length;) {
+				inotify_event* event = (inotify_event*)ptr;
+				if (event->len > 0)
+					changed.insert(event->name);
+
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+
+		bool includeChanged = false;
+		for (const std::string& name : changed) {
+			if (isShaderStage(name))
+				compile(name);
+			else if (std::filesystem::path(name).extension() == ".glsl")
+				includeChanged = true;
+		}
+
+		// no dependency tracking, a changed include recompiles every stage
+		if (!includeChanged)
+			continue;
+
+		for (const auto& entry : std::filesystem::directory_iterator(m_sourceDir)) {
+			std::string name = entry.path().filename().string();
+			if (isShaderStage(entry.path()) && !changed.contains(name))
+				compile(name);
+		}
+	}
+}
+
+void VkeShaderWatcher::compile(const std::string& name) {
+	std::string source = (std::filesystem::path(m_sourceDir) / name).string();
+	std::string output = (std::filesystem::path(m_outputDir) / (name + ".spv")).string();
+
+	// glslc reports the errors itself, a failed compile leaves the previous .spv in place
+	std::string command = fmt::format("glslc \"{}\" -o \"{}\"", source, output);
+	if (std::system(command.c_str()) != 0) {
+		fmt::println("Failed to compile {}", source);
+		return;
+	}
+
+	fmt::println("Shader compiled: {}", output);
+
+	std::lock_guard lock(m_mutex);
+	m_compiled.insert(output);
+}
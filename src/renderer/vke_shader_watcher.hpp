@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vke_types.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace vke {
+
+// watches the GLSL sources with inotify and recompiles the changed ones with glslc on its own thread
+class VkeShaderWatcher {
+public:
+	VkResult init(const char* sourceDir, const char* outputDir);
+	void destroy();
+
+	std::vector<std::string> takeCompiledShaders(); // .spv paths rebuilt since the last call
+
+private:
+	std::string m_sourceDir;
+	std::string m_outputDir;
+
+	int m_inotify{-1};
+	std::thread m_thread;
+	std::atomic<bool> m_stopping{false};
+
+	std::mutex m_mutex;
+	std::set<std::string> m_compiled;
+
+	void watchLoop();
+	void compile(const std::string& name);
+};
+
+} // namespace vke
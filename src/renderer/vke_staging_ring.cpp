@@ -0,0 +1,72 @@
+#include "vke_staging_ring.hpp"
+
+using namespace vke;
+
+void VkeStagingRing::init(AllocatedBuffer* buffer) {
+	m_buffer = buffer->buffer;
+	m_mappedData = (char*)buffer->info.pMappedData;
+	m_capacity = buffer->info.size;
+	m_head = 0;
+	m_regions.clear();
+}
+
+bool VkeStagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation) {
+	if (size == 0 || size > m_capacity)
+		return false;
+
+	VkDeviceSize offset = 0;
+
+	if (!m_regions.empty()) {
+		VkDeviceSize tail = m_regions.front().begin;
+		VkDeviceSize aligned = (m_head + alignment - 1) & ~(alignment - 1);
+
+		if (m_head > tail) {
+			// live data is in [tail, head), try the end of the buffer and then wrap around
+			if (aligned + size <= m_capacity)
+				offset = aligned;
+			else if (size <= tail)
+				offset = 0;
+			else
+				return false;
+		} else if (m_head < tail) {
+			// already wrapped, free space is [head, tail)
+			if (aligned + size > tail)
+				return false;
+
+			offset = aligned;
+		} else {
+			return false;
+		}
+	}
+
+	m_head = offset + size;
+	m_regions.push_back({.begin = offset, .end = m_head, .submission = PENDING_SUBMISSION});
+
+	allocation->offset = offset;
+	allocation->data = m_mappedData + offset;
+
+	m_stats.bytesStagedFrame += size;
+	m_stats.bytesStagedTotal += size;
+
+	return true;
+}
+
+void VkeStagingRing::markSubmitted(uint64_t submission) {
+	for (auto it = m_regions.rbegin(); it != m_regions.rend() && it->submission == PENDING_SUBMISSION; it++)
+		it->submission = submission;
+}
+
+void VkeStagingRing::retire(uint64_t completedSubmission) {
+	while (!m_regions.empty() && m_regions.front().submission <= completedSubmission)
+		m_regions.pop_front();
+}
+
+void VkeStagingRing::recordStall() {
+	m_stats.stallsFrame++;
+	m_stats.stallsTotal++;
+}
+
+void VkeStagingRing::newFrame() {
+	m_stats.bytesStagedFrame = 0;
+	m_stats.stallsFrame = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vke_types.hpp"
+
+namespace vke {
+
+// persistently mapped upload buffer; regions are tagged with the submission that reads them
+// and handed back once that submission has been retired by the GPU
+class VkeStagingRing {
+public:
+	struct Allocation {
+		VkDeviceSize offset;
+		void* data;
+	};
+
+	struct Stats {
+		size_t bytesStagedFrame;
+		size_t bytesStagedTotal;
+		uint32_t stallsFrame; // flushes forced by the ring being full
+		uint32_t stallsTotal;
+	};
+
+	VkeStagingRing(){};
+
+	void init(AllocatedBuffer* buffer);
+
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation* allocation);
+	void markSubmitted(uint64_t submission);
+	void retire(uint64_t completedSubmission);
+
+	void recordStall();
+	void newFrame();
+
+	VkBuffer getBuffer() { return m_buffer; }
+	VkDeviceSize getCapacity() { return m_capacity; }
+	Stats getStats() { return m_stats; }
+
+private:
+	static constexpr uint64_t PENDING_SUBMISSION = UINT64_MAX;
+
+	struct Region {
+		VkDeviceSize begin;
+		VkDeviceSize end;
+		uint64_t submission;
+	};
+
+	VkBuffer m_buffer;
+	char* m_mappedData;
+	VkDeviceSize m_capacity;
+	VkDeviceSize m_head{0};
+
+	std::deque<Region> m_regions; // oldest first
+
+	Stats m_stats{};
+};
+
+} // namespace vke
@@ -23,7 +23,7 @@ public:
 	VkSwapchainKHR& get_swapchain() { return m_swapchain; }
 
 private:
-	VkeDevice* m_device;
+	VkeDevice* m_device{nullptr};
 
 	VkSwapchainKHR m_swapchain;
 	VkFormat m_swapchainImageFormat;
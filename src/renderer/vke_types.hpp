@@ -7,6 +7,7 @@
 #include <span>
 #include <deque>
 #include <functional>
+#include <vector>
 #include <vulkan/vulkan.h>
 #include <VkBootstrap.h>
 #include <GLFW/glfw3.h>
@@ -14,16 +15,36 @@
 
 #include <vk_mem_alloc.h>
 
+// how one mip level of one layer was last used, barriers wait on it and are skipped when it already allows the next use
+struct VkeSubresourceState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE; // last write and every access since
+	VkAccessFlags2 access = VK_ACCESS_2_NONE; // last write
+	VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE; // the last write or transition is visible to these
+};
+
 struct VkeImage {
-	VkImageLayout currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	VkImage image;
 	VkImageView imageView;
+	VkImageAspectFlags aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+	uint32_t mipLevels{1};
+	uint32_t arrayLayers{1};
+	std::vector<VkeSubresourceState> subresources = std::vector<VkeSubresourceState>(1); // mips of layer 0 first
+
+	void resetState(uint32_t mips, uint32_t layers) {
+		mipLevels = mips;
+		arrayLayers = layers;
+		subresources.assign(mips * layers, {});
+	}
+
+	VkeSubresourceState& getState(uint32_t mip = 0, uint32_t layer = 0) { return subresources[layer * mipLevels + mip]; }
 };
 
 struct AllocatedImage : VkeImage {
 	VmaAllocation allocation;
 	VkExtent3D imageExtent;
 	VkFormat imageFormat;
+	uint32_t bindlessIndex{UINT32_MAX}; // handle in the bindless heap, only for sampled images
 };
 
 struct AllocatedBuffer {
@@ -32,15 +53,20 @@ struct AllocatedBuffer {
 	VmaAllocationInfo info;
 };
 
+// ranges inside the device geometry arena, drawn with vkCmdDrawIndexed(indexCount, 1, firstIndex, vertexOffset, 0)
 struct GPUMeshBuffers {
-	AllocatedBuffer indexBuffer;
-	AllocatedBuffer vertexBuffer;
-	VkDeviceAddress vertexBufferAddress;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	uint32_t vertexCount;
+	VkDeviceAddress vertexBufferAddress; // base address of the arena vertex buffer
 };
 
 struct GPUDrawPushConstants {
 	glm::mat4 worldMatrix;
 	VkDeviceAddress vertexBuffer;
+	uint32_t textureIndex; // bindless handles
+	uint32_t samplerIndex;
 };
 
 struct Vertex {
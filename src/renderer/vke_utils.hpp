@@ -1,19 +1,182 @@
 #pragma once
 
+#include "vke_bindless.hpp"
+#include "vke_range_allocator.hpp"
 #include "vke_types.hpp"
 
 namespace vkutil {
 
+// FNV-1a, chain calls by passing the previous hash
+constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HASH_SEED) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t hash = HASH_SEED) {
+	static_assert(std::is_trivially_copyable_v<T>, "only plain data can be hashed byte-wise");
+	return hashBytes(&value, sizeof(T), hash);
+}
+
+// flat key for hashed caches, compared in full so hash collisions never alias two entries
+struct HashKey {
+	std::vector<uint8_t> bytes;
+
+	template <typename... T>
+	void add(const T&... values) {
+		(append(values), ...);
+	}
+
+	template <typename T>
+	void addRange(std::span<const T> values) {
+		for (const T& value : values)
+			append(value);
+	}
+
+	uint64_t hash() const { return hashBytes(bytes.data(), bytes.size()); }
+	bool operator==(const HashKey& other) const = default;
+
+private:
+	template <typename T>
+	void append(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>, "only plain data can be added to a key");
+		const uint8_t* data = (const uint8_t*)&value;
+		bytes.insert(bytes.end(), data, data + sizeof(T));
+	}
+};
+
+struct HashKeyHasher {
+	size_t operator()(const HashKey& key) const { return (size_t)key.hash(); }
+};
+
+// typed handle records in one flat vector, flushed in reverse order without any per-entry allocation
 struct DeletionQueue {
-	std::deque<std::function<void()>> deletors;
+	enum class Type : uint8_t {
+		Buffer,
+		Image,
+		ImageView,
+		Sampler,
+		Pipeline,
+		PipelineLayout,
+		DescriptorSetLayout,
+		DescriptorPool,
+		DescriptorSet,
+		CommandPool,
+		Fence,
+		Semaphore,
+		ShaderModule,
+		Allocation,
+		Range, // of a range allocator, e.g. geometry arena space
+		BindlessImage, // handle of the bindless heap, reused by the next image registered
+	};
+
+	struct Entry {
+		Type type;
+		uint32_t rangeSize; // fits in the padding after the type
+		uint64_t handle;
+		uint64_t secondHandle; // image view of an image, pool of a descriptor set
+		VmaAllocation allocation;
+	};
+
+	std::vector<Entry> entries;
+
+	void pushBuffer(VkBuffer buffer, VmaAllocation allocation) { push(Type::Buffer, (uint64_t)buffer, 0, allocation); }
+	void pushBuffer(const AllocatedBuffer& buffer) { pushBuffer(buffer.buffer, buffer.allocation); }
+
+	void pushImage(VkImage image, VkImageView view, VmaAllocation allocation) {
+		push(Type::Image, (uint64_t)image, (uint64_t)view, allocation);
+	}
+
+	void pushImageView(VkImageView view) { push(Type::ImageView, (uint64_t)view); }
+	void pushSampler(VkSampler sampler) { push(Type::Sampler, (uint64_t)sampler); }
+	void pushPipeline(VkPipeline pipeline) { push(Type::Pipeline, (uint64_t)pipeline); }
+	void pushPipelineLayout(VkPipelineLayout layout) { push(Type::PipelineLayout, (uint64_t)layout); }
+	void pushDescriptorSetLayout(VkDescriptorSetLayout layout) { push(Type::DescriptorSetLayout, (uint64_t)layout); }
+	void pushDescriptorPool(VkDescriptorPool pool) { push(Type::DescriptorPool, (uint64_t)pool); }
+	void pushDescriptorSet(VkDescriptorPool pool, VkDescriptorSet set) {
+		push(Type::DescriptorSet, (uint64_t)set, (uint64_t)pool);
+	}
+	void pushCommandPool(VkCommandPool pool) { push(Type::CommandPool, (uint64_t)pool); }
+	void pushFence(VkFence fence) { push(Type::Fence, (uint64_t)fence); }
+	void pushSemaphore(VkSemaphore semaphore) { push(Type::Semaphore, (uint64_t)semaphore); }
+	void pushShaderModule(VkShaderModule module) { push(Type::ShaderModule, (uint64_t)module); }
+	void pushAllocation(VmaAllocation allocation) { push(Type::Allocation, 0, 0, allocation); } // memory without a resource
+	void pushRange(vke::VkeRangeAllocator& ranges, uint64_t offset, uint32_t size) {
+		entries.push_back({.type = Type::Range, .rangeSize = size, .handle = (uint64_t)&ranges, .secondHandle = offset});
+	}
+	void pushBindlessImage(vke::VkeBindlessHeap& heap, uint32_t handle) {
+		push(Type::BindlessImage, (uint64_t)&heap, handle);
+	}
 
-	void push_function(std::function<void()>&& deletor) { deletors.push_back(deletor); }
+	void flush(VkDevice device, VmaAllocator allocator) {
+		for (auto it = entries.rbegin(); it != entries.rend(); it++) {
+			switch (it->type) {
+			case Type::Buffer:
+				vmaDestroyBuffer(allocator, (VkBuffer)it->handle, it->allocation);
+				break;
+			case Type::Image:
+				vkDestroyImageView(device, (VkImageView)it->secondHandle, nullptr);
+				vmaDestroyImage(allocator, (VkImage)it->handle, it->allocation);
+				break;
+			case Type::ImageView:
+				vkDestroyImageView(device, (VkImageView)it->handle, nullptr);
+				break;
+			case Type::Sampler:
+				vkDestroySampler(device, (VkSampler)it->handle, nullptr);
+				break;
+			case Type::Pipeline:
+				vkDestroyPipeline(device, (VkPipeline)it->handle, nullptr);
+				break;
+			case Type::PipelineLayout:
+				vkDestroyPipelineLayout(device, (VkPipelineLayout)it->handle, nullptr);
+				break;
+			case Type::DescriptorSetLayout:
+				vkDestroyDescriptorSetLayout(device, (VkDescriptorSetLayout)it->handle, nullptr);
+				break;
+			case Type::DescriptorPool:
+				vkDestroyDescriptorPool(device, (VkDescriptorPool)it->handle, nullptr);
+				break;
+			case Type::DescriptorSet: {
+				VkDescriptorSet set = (VkDescriptorSet)it->handle;
+				vkFreeDescriptorSets(device, (VkDescriptorPool)it->secondHandle, 1, &set);
+				break;
+			}
+			case Type::CommandPool:
+				vkDestroyCommandPool(device, (VkCommandPool)it->handle, nullptr);
+				break;
+			case Type::Fence:
+				vkDestroyFence(device, (VkFence)it->handle, nullptr);
+				break;
+			case Type::Semaphore:
+				vkDestroySemaphore(device, (VkSemaphore)it->handle, nullptr);
+				break;
+			case Type::ShaderModule:
+				vkDestroyShaderModule(device, (VkShaderModule)it->handle, nullptr);
+				break;
+			case Type::Allocation:
+				vmaFreeMemory(allocator, it->allocation);
+				break;
+			case Type::Range:
+				((vke::VkeRangeAllocator*)it->handle)->free(it->secondHandle, it->rangeSize);
+				break;
+			case Type::BindlessImage:
+				((vke::VkeBindlessHeap*)it->handle)->releaseImage((uint32_t)it->secondHandle);
+				break;
+			}
+		}
 
-	void flush() {
-		for (auto it = deletors.rbegin(); it != deletors.rend(); it++)
-			(*it)();
+		entries.clear(); // keeps the capacity for the next frame
+	}
 
-		deletors.clear();
+private:
+	void push(Type type, uint64_t handle, uint64_t secondHandle = 0, VmaAllocation allocation = VK_NULL_HANDLE) {
+		entries.push_back({.type = type, .handle = handle, .secondHandle = secondHandle, .allocation = allocation});
 	}
 };
 
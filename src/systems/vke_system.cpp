@@ -1,10 +1,151 @@
 #include "vke_system.hpp"
 
+#include <chrono>
+#include <cstdlib>
+#include <cxxabi.h>
+
 using namespace vke;
 
+static uint64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void VkeSystemManager::init(VkeJobSystem* jobSystem) { m_jobSystem = jobSystem; }
+
 void VkeSystemManager::updateAll(float deltaTime) {
-	for (auto& system : systems)
-		system->update(deltaTime);
+	VKE_PROFILE_SCOPE("updateSystems");
+	run([deltaTime](VkeSystem& system) { system.update(deltaTime); }, true);
+}
+
+void VkeSystemManager::fixedUpdateAll(float fixedDeltaTime) {
+	VKE_PROFILE_SCOPE("fixedUpdateSystems");
+	run([fixedDeltaTime](VkeSystem& system) { system.fixedUpdate(fixedDeltaTime); }, false);
+}
+
+bool VkeSystemManager::conflicts(const SystemNode& a, const SystemNode& b) {
+	if (a._exclusive || b._exclusive)
+		return true;
+
+	for (const ComponentAccess& first : a._accesses) {
+		for (const ComponentAccess& second : b._accesses) {
+			if (first._type == second._type && (first._write || second._write))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void VkeSystemManager::buildSchedule() {
+	// edges only go from earlier to later systems, registration order is a topological order of the graph
+	for (SystemNode& node : m_nodes) {
+		node._dependents.clear();
+		node._dependencies = 0;
+	}
+
+	for (uint32_t later = 0; later < m_nodes.size(); later++) {
+		for (uint32_t earlier = 0; earlier < later; earlier++) {
+			if (!conflicts(m_nodes[earlier], m_nodes[later]))
+				continue;
+
+			m_nodes[earlier]._dependents.push_back(later);
+			m_nodes[later]._dependencies++;
+		}
+	}
+
+	m_scheduleDirty = false;
+}
+
+void VkeSystemManager::run(std::function<void(VkeSystem&)>&& function, bool recordStats) {
+	if (systems.empty())
+		return;
+
+	if (m_scheduleDirty)
+		buildSchedule();
+
+	// a view creates the pool it is missing, which would modify the registry while other systems iterate it
+	if (m_engine->hasCurrentScene()) {
+		VkeScene& scene = m_engine->getCurrentScene();
+		for (SystemNode& node : m_nodes) {
+			for (const ComponentAccess& access : node._accesses)
+				access._reserve(scene);
+		}
+	}
+
+	uint64_t start = nowNs();
+
+	for (SystemNode& node : m_nodes)
+		node._remaining.store(node._dependencies, std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < m_nodes.size(); i++) {
+		if (m_nodes[i]._dependencies == 0)
+			m_jobSystem->run([this, i, &function] { runNode(i, function); }, &m_counter);
+	}
+
+	// systems submit their dependents before they finish, the counter only drops to zero once every system has run
+	m_jobSystem->wait(m_counter);
+
+	if (!recordStats)
+		return;
+
+	// longest chain ending at each system, walked in registration order
+	std::vector<uint64_t> chainNs(m_nodes.size(), 0);
+	std::vector<uint32_t> previous(m_nodes.size(), UINT32_MAX);
+
+	m_stats = {.wallMs = (nowNs() - start) / 1e6};
+
+	uint32_t last = 0;
+	for (uint32_t i = 0; i < m_nodes.size(); i++) {
+		const SystemNode& node = m_nodes[i];
+		chainNs[i] += node._endNs - node._startNs;
+
+		for (uint32_t dependent : node._dependents) {
+			if (chainNs[i] > chainNs[dependent]) {
+				chainNs[dependent] = chainNs[i];
+				previous[dependent] = i;
+			}
+		}
+
+		if (chainNs[i] > chainNs[last])
+			last = i;
+
+		m_stats.systems.push_back({
+			.name = systems[i]->m_name.c_str(),
+			.ms = (node._endNs - node._startNs) / 1e6,
+			.critical = false,
+		});
+	}
+
+	m_stats.criticalPathMs = chainNs[last] / 1e6;
+	for (uint32_t i = last; i != UINT32_MAX; i = previous[i])
+		m_stats.systems[i].critical = true;
+}
+
+void VkeSystemManager::runNode(uint32_t index, const std::function<void(VkeSystem&)>& function) {
+	SystemNode& node = m_nodes[index];
+	node._startNs = nowNs();
+
+	{
+		VKE_PROFILE_SCOPE(systems[index]->m_name.c_str());
+		function(*systems[index]);
+	}
+
+	node._endNs = nowNs();
+
+	for (uint32_t dependent : node._dependents) {
+		if (m_nodes[dependent]._remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			m_jobSystem->run([this, dependent, &function] { runNode(dependent, function); }, &m_counter);
+	}
+}
+
+std::string VkeSystemManager::typeName(const char* mangledName) {
+	int status;
+	char* demangled = abi::__cxa_demangle(mangledName, nullptr, nullptr, &status);
+
+	std::string name = status == 0 ? demangled : mangledName;
+	free(demangled);
+
+	return name;
 }
 
 void VkeSystemManager::awakeAll() {
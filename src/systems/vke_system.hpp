@@ -11,7 +11,8 @@ class VkeSystem {
 	friend class VkeSystemManager;
 
 public:
-	virtual void update(float deltaTime) = 0;
+	virtual void update(float deltaTime) = 0; // once per frame, with the measured frame time
+	virtual void fixedUpdate(float fixedDeltaTime) {} // zero or more times per frame, always with the same step
 	virtual void awake() {}
 	virtual void sleep() {}
 	virtual void windowResized() {}
@@ -21,6 +22,9 @@ public:
 
 protected: // TODO: make this private
 	VkEngine* m_engine;
+
+private:
+	std::string m_name; // its profiling zone, from the type name
 };
 
 // for other type of systems, which includes particular methods, which we provide to the user
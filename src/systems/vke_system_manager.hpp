@@ -1,6 +1,14 @@
 #pragma once
 
+#include "../assets/vke_scene.hpp"
+#include "../renderer/vke_job_system.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <string>
+#include <typeinfo>
 #include <vector>
 
 namespace vke {
@@ -8,20 +16,108 @@ namespace vke {
 class VkEngine;
 class VkeSystem;
 
+// component types a system touches, declared as `using Reads = VkeComponents<...>` and `using Writes = ...`
+template <typename... Components>
+struct VkeComponents {};
+
+// pseudo component for systems that call into the engine, e.g. to queue draws, they never run alongside each other
+struct VkeEngineAccess {};
+
+// time spent in one system during the last update
+struct SystemTiming {
+	const char* name;
+	double ms;
+	bool critical; // on the critical path
+};
+
+struct SystemScheduleStats {
+	std::vector<SystemTiming> systems; // in registration order
+	double wallMs;
+	double criticalPathMs; // longest chain of dependent systems, the wall time with unlimited workers
+};
+
+// systems run as jobs: two systems only run at the same time when neither writes a component the other one
+// touches, otherwise they keep their registration order, so the results do not depend on the scheduling; systems that
+// declare no components are treated as touching everything
 class VkeSystemManager {
 public:
+	void init(VkeJobSystem* jobSystem);
+
 	template <typename T>
 	void registerSystem(VkEngine* engine) {
 		auto system = std::make_unique<T>();
 		system->m_engine = engine;
+		system->m_name = typeName(typeid(T).name());
+
+		SystemNode& node = m_nodes.emplace_back();
+		node._exclusive = true;
+
+		if constexpr (requires { typename T::Reads; }) {
+			addAccesses(node, typename T::Reads{}, false);
+			node._exclusive = false;
+		}
+
+		if constexpr (requires { typename T::Writes; }) {
+			addAccesses(node, typename T::Writes{}, true);
+			node._exclusive = false;
+		}
+
+		m_engine = engine;
+		m_scheduleDirty = true;
 		systems.push_back(std::move(system));
 	}
 
 	void updateAll(float deltaTime);
+	void fixedUpdateAll(float fixedDeltaTime);
 	void awakeAll();
 
+	const SystemScheduleStats& getStats() { return m_stats; } // of the last updateAll
+
 private:
+	struct ComponentAccess {
+		entt::id_type _type;
+		bool _write;
+		void (*_reserve)(VkeScene& scene);
+	};
+
+	struct SystemNode {
+		std::vector<ComponentAccess> _accesses;
+		bool _exclusive;
+
+		std::vector<uint32_t> _dependents; // later systems that wait for this one
+		uint32_t _dependencies;
+		std::atomic<uint32_t> _remaining; // dependencies still running this update
+
+		uint64_t _startNs;
+		uint64_t _endNs;
+	};
+
 	std::vector<std::unique_ptr<VkeSystem>> systems;
+	std::deque<SystemNode> m_nodes; // stable, the atomics cannot move
+
+	VkEngine* m_engine{nullptr};
+	VkeJobSystem* m_jobSystem{nullptr};
+	VkeJobCounter m_counter; // systems of the running update
+	bool m_scheduleDirty{false};
+
+	SystemScheduleStats m_stats;
+
+	template <typename... Components>
+	static void addAccesses(SystemNode& node, VkeComponents<Components...>, bool write) {
+		(node._accesses.push_back({entt::type_hash<Components>::value(), write, &reserveComponent<Components>}), ...);
+	}
+
+	template <typename T>
+	static void reserveComponent(VkeScene& scene) {
+		scene.reserveComponent<T>();
+	}
+
+	static bool conflicts(const SystemNode& a, const SystemNode& b);
+	static std::string typeName(const char* mangledName);
+
+	void buildSchedule();
+	void run(std::function<void(VkeSystem&)>&& function, bool recordStats);
+	void runNode(uint32_t index, const std::function<void(VkeSystem&)>& function);
 };
 
 } // namespace vke
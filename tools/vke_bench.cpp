@@ -0,0 +1,376 @@
+#include "engine/vke_engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <numbers>
+#include <sstream>
+#include <string_view>
+
+using namespace vke;
+
+// scripted scenes rendered headless for a fixed number of frames, results are written as JSON and can be compared
+// against a stored baseline; without a GPU, point the loader at lavapipe (VK_DRIVER_FILES=.../lvp_icd.x86_64.json)
+constexpr uint32_t BENCH_WARMUP_FRAMES = 10; // pipeline compiles and first uploads, not measured
+constexpr uint32_t BENCH_DEFAULT_FRAMES = 300;
+constexpr double BENCH_DEFAULT_THRESHOLD = 0.10; // relative slowdown flagged as a regression
+
+// materials are textures in the bindless heap, every entity draws one mesh with one of them
+struct BenchScene {
+	const char* name;
+	uint32_t meshes;
+	uint32_t entities;
+	uint32_t materials;
+	uint32_t dispatches; // gradient passes per frame, one invocation per pixel each
+	uint32_t width;
+	uint32_t height;
+};
+
+static const BenchScene BENCH_SCENES[] = {
+	{.name = "gradient_720p", .dispatches = 1, .width = 1280, .height = 720},
+	{.name = "gradient_1080p_x4", .dispatches = 4, .width = 1920, .height = 1080},
+	{.name = "meshes_256", .meshes = 256, .entities = 256, .materials = 1, .width = 1280, .height = 720},
+	{.name = "entities_4096", .meshes = 16, .entities = 4096, .materials = 16, .width = 1280, .height = 720},
+	{.name = "materials_1024", .meshes = 64, .entities = 1024, .materials = 1024, .width = 1280, .height = 720},
+	{.name = "mixed", .meshes = 64, .entities = 2048, .materials = 64, .dispatches = 1, .width = 1280, .height = 720},
+	{.name = "draws_50k", .meshes = 64, .entities = 50000, .materials = 64, .width = 1280, .height = 720},
+};
+
+struct BenchEntity {
+	glm::vec2 position;
+	float angle;
+	float speed;
+	uint32_t mesh;
+	uint32_t material;
+};
+
+// metric name to value, in the order they are written
+using BenchResult = std::vector<std::pair<std::string, double>>;
+
+class BenchApplication : public Application {
+public:
+	explicit BenchApplication(const BenchScene& scene) : m_scene(scene) {}
+
+	const BenchScene& m_scene;
+	std::vector<GPUMeshBuffers> m_meshes;
+	std::vector<AllocatedImage> m_textures;
+	std::vector<double> m_frameTimes; // milliseconds, measured frames only
+
+	void setup() override;
+};
+
+// drives the scene: one update per frame, so the time between two updates is the CPU frame time
+class BenchSystem : public VkeSystem {
+public:
+	void update(float deltaTime) override {
+		BenchApplication& app = *static_cast<BenchApplication*>(m_engine);
+
+		auto now = std::chrono::steady_clock::now();
+		if (m_frame++ > BENCH_WARMUP_FRAMES)
+			app.m_frameTimes.push_back(std::chrono::duration<double, std::milli>(now - m_lastUpdate).count());
+		m_lastUpdate = now;
+
+		for (uint32_t i = 0; i < app.m_scene.dispatches; i++)
+			app.drawComputeTest();
+
+		currentScene().getEntities<BenchEntity>().each([&app](BenchEntity& entity) {
+			entity.angle += entity.speed;
+
+			glm::mat4 world = glm::mat4{1.f};
+			world[3] = glm::vec4(entity.position, 0.f, 1.f);
+			world[0] = glm::vec4(std::cos(entity.angle), std::sin(entity.angle), 0.f, 0.f) * 0.05f;
+			world[1] = glm::vec4(-std::sin(entity.angle), std::cos(entity.angle), 0.f, 0.f) * 0.05f;
+
+			app.drawMesh(app.m_meshes[entity.mesh], world, app.m_textures[entity.material].bindlessIndex);
+		});
+	}
+
+private:
+	uint32_t m_frame{0};
+	std::chrono::steady_clock::time_point m_lastUpdate;
+};
+
+void BenchApplication::setup() {
+	VkeDevice& device = getDevice();
+
+	device.beginUploadBatch();
+
+	// fans with a different vertex count each, so every mesh has its own ranges in the arena
+	for (uint32_t i = 0; i < m_scene.meshes; i++) {
+		uint32_t sides = 3 + i % 29;
+
+		std::vector<Vertex> vertices(sides + 1);
+		std::vector<uint32_t> indices;
+
+		vertices[0] = {.color = {1.f, 1.f, 1.f, 1.f}};
+		for (uint32_t side = 0; side < sides; side++) {
+			float angle = 2.f * std::numbers::pi_v<float> * side / sides;
+			vertices[side + 1] = {
+				.position = {std::cos(angle), std::sin(angle), 0.f},
+				.uv_x = std::cos(angle) * 0.5f + 0.5f,
+				.uv_y = std::sin(angle) * 0.5f + 0.5f,
+				.color = {(float)side / sides, 0.5f, 1.f - (float)side / sides, 1.f},
+			};
+
+			indices.insert(indices.end(), {0, side + 1, (side + 1) % sides + 1});
+		}
+
+		GPUMeshBuffers& mesh = m_meshes.emplace_back();
+		VK_CHECK(device.uploadMesh(&mesh, indices, vertices));
+	}
+
+	for (uint32_t i = 0; i < m_scene.materials; i++) {
+		uint32_t color = glm::packUnorm4x8(glm::vec4((i % 7) / 6.f, (i % 11) / 10.f, (i % 13) / 12.f, 1.f));
+
+		AllocatedImage& texture = m_textures.emplace_back();
+		VK_CHECK(device.createFilledImage(&texture, &color, {1, 1, 1}, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT));
+	}
+
+	VK_CHECK(device.endUploadBatch());
+
+	std::shared_ptr<VkeScene> scene = createScene("bench");
+
+	// deterministic layout, the same scene draws the same thing on every run
+	for (uint32_t i = 0; i < m_scene.entities; i++) {
+		scene->addEntity<BenchEntity>(BenchEntity{
+			.position = {(i % 64) / 32.f - 1.f, (i / 64 % 64) / 32.f - 1.f},
+			.angle = (float)i,
+			.speed = 0.01f + (i % 5) * 0.005f,
+			.mesh = i % std::max(m_scene.meshes, 1u),
+			.material = i % std::max(m_scene.materials, 1u),
+		});
+	}
+
+	switchScene("bench");
+	registerSystem<BenchSystem>();
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+	if (values.empty())
+		return 0.0;
+
+	std::sort(values.begin(), values.end());
+	return values[(size_t)std::ceil(values.size() * fraction) - 1];
+}
+
+static BenchResult runScene(const BenchScene& scene, uint32_t frames) {
+	GameEngineSettings settings = VkEngine::defaultSettings;
+	settings.appName = "Vulkan Engine Bench";
+	settings.windowWidth = scene.width;
+	settings.windowHeight = scene.height;
+	settings.headless = true;
+	settings.frameLimit = BENCH_WARMUP_FRAMES + 1 + frames;
+	settings.shaderSourceDir = nullptr;
+	settings.cpuTracePath = nullptr;
+
+	// engines are large, and every scene gets a fresh one
+	auto app = std::make_unique<BenchApplication>(scene);
+	app->init(settings);
+	app->run();
+
+	double total = 0.0;
+	for (double time : app->m_frameTimes)
+		total += time;
+
+	// scopes are timed one by one, the gradient one is recorded once per dispatch
+	double gpuTotal = 0.0;
+	BenchResult gpuScopes;
+	for (const VkeGpuProfiler::ScopeStats& stats : app->getGpuProfiler().getStats()) {
+		gpuTotal += stats.avgMs * (stats.name == "gradient" ? scene.dispatches : 1);
+		gpuScopes.push_back({fmt::format("gpu.{}.avgMs", stats.name), stats.avgMs});
+		gpuScopes.push_back({fmt::format("gpu.{}.p99Ms", stats.name), stats.p99Ms});
+	}
+
+	VkeDevice& device = app->getDevice();
+	DeviceMemoryStats memory = device.getMemoryStats();
+	VkePipelineRegistry::Stats pipelines = device.getPipelineRegistryStats();
+	VkeDescriptorCache::Stats descriptors = device.getDescriptorCacheStats();
+	VkeDescriptorAllocator::Stats descriptorPools = device.getDescriptorAllocatorStats();
+
+	BenchResult result = {
+		{"frames", (double)app->m_frameTimes.size()},
+		{"draws", (double)scene.entities},
+		{"cpuFrameMs.avg", app->m_frameTimes.empty() ? 0.0 : total / app->m_frameTimes.size()},
+		{"cpuFrameMs.p50", percentile(app->m_frameTimes, 0.50)},
+		{"cpuFrameMs.p99", percentile(app->m_frameTimes, 0.99)},
+		{"gpuFrameMs.avg", gpuTotal},
+	};
+
+	result.insert(result.end(), gpuScopes.begin(), gpuScopes.end());
+	result.insert(result.end(), {
+		{"memory.allocations", (double)memory.allocations},
+		{"memory.allocationBytes", (double)memory.allocationBytes},
+		{"memory.blocks", (double)memory.blocks},
+		{"memory.blockBytes", (double)memory.blockBytes},
+		{"pipelines.unique", (double)pipelines.uniquePipelines},
+		{"pipelines.layouts", (double)pipelines.uniqueLayouts},
+		{"descriptors.cachedSets", (double)descriptors.cachedSets},
+		{"descriptors.cacheMisses", (double)descriptors.misses},
+		{"descriptors.cacheHits", (double)descriptors.hits},
+		{"descriptors.poolsCreated", (double)descriptorPools.poolsCreated},
+		{"descriptors.setsAllocated", (double)descriptorPools.setsAllocated},
+		{"descriptors.setsHighWaterMark", (double)descriptorPools.setsHighWaterMark},
+	});
+
+	app->destroy();
+
+	return result;
+}
+
+static VkResult writeResults(const char* path, const std::vector<std::pair<std::string, BenchResult>>& results) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	file << "{\"scenes\":[";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		file << fmt::format("{}\n{{\"name\":\"{}\"", i == 0 ? "" : ",", results[i].first);
+		for (const auto& [metric, value] : results[i].second)
+			file << fmt::format(",\"{}\":{}", metric, value);
+		file << "}";
+	}
+
+	file << "\n]}\n";
+	file.close();
+
+	return file.fail() ? VK_ERROR_INITIALIZATION_FAILED : VK_SUCCESS;
+}
+
+// reads back what writeResults wrote: scenes of flat "metric": number pairs, keyed as "scene/metric"
+static VkResult readResults(const char* path, std::map<std::string, double>* results) {
+	std::ifstream file(path);
+	if (!file.is_open())
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string text = buffer.str();
+
+	std::string scene;
+	size_t pos = 0;
+
+	while ((pos = text.find('"', pos)) != std::string::npos) {
+		size_t end = text.find('"', pos + 1);
+		size_t colon = text.find_first_not_of(" \t\n", end + 1);
+		if (end == std::string::npos || colon == std::string::npos || text[colon] != ':') {
+			pos = end == std::string::npos ? end : end + 1;
+			continue;
+		}
+
+		std::string key = text.substr(pos + 1, end - pos - 1);
+		size_t value = text.find_first_not_of(" \t\n", colon + 1);
+
+		if (text[value] == '"') {
+			size_t valueEnd = text.find('"', value + 1);
+			if (key == "name")
+				scene = text.substr(value + 1, valueEnd - value - 1);
+			pos = valueEnd + 1;
+		} else if (text[value] == '[' || text[value] == '{') {
+			pos = value;
+		} else {
+			size_t parsed = 0;
+			(*results)[scene + "/" + key] = std::stod(text.substr(value), &parsed);
+			pos = value + parsed;
+		}
+	}
+
+	return VK_SUCCESS;
+}
+
+// every compared metric is lower-is-better: timings get the threshold as slack, counts are flagged on any increase;
+// frames, draws and cache hits only describe the run
+static uint32_t compareResults(const std::vector<std::pair<std::string, BenchResult>>& results,
+							   const std::map<std::string, double>& baseline, double threshold) {
+	uint32_t regressions = 0;
+
+	for (const auto& [scene, result] : results) {
+		for (const auto& [metric, value] : result) {
+			auto it = baseline.find(scene + "/" + metric);
+			if (it == baseline.end() || metric == "frames" || metric == "draws" || metric == "descriptors.cacheHits")
+				continue;
+
+			bool timing = metric.find("Ms") != std::string::npos;
+			double limit = timing ? it->second * (1.0 + threshold) : it->second;
+			if (value <= limit)
+				continue;
+
+			fmt::println("REGRESSION {}/{}: {:.3f} against {:.3f} ({:+.1f}%)", scene, metric, value, it->second,
+						 it->second > 0.0 ? (value / it->second - 1.0) * 100.0 : 100.0);
+			regressions++;
+		}
+	}
+
+	return regressions;
+}
+
+int main(int argc, char* argv[]) {
+	const char* outputPath = "bench_results.json";
+	const char* baselinePath = nullptr;
+	const char* sceneFilter = nullptr;
+	uint32_t frames = BENCH_DEFAULT_FRAMES;
+	double threshold = BENCH_DEFAULT_THRESHOLD;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+
+		if (arg == "--frames" && i + 1 < argc)
+			frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--output" && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (arg == "--compare" && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc)
+			threshold = std::strtod(argv[++i], nullptr);
+		else if (arg == "--scene" && i + 1 < argc)
+			sceneFilter = argv[++i];
+		else {
+			fmt::println("usage: {} [--frames n] [--output results.json] [--scene name] [--compare baseline.json] "
+						 "[--threshold 0.1]",
+						 argv[0]);
+			return 1;
+		}
+	}
+
+	std::map<std::string, double> baseline;
+	if (baselinePath && readResults(baselinePath, &baseline) != VK_SUCCESS) {
+		fmt::println("Cannot read the baseline {}", baselinePath);
+		return 1;
+	}
+
+	std::vector<std::pair<std::string, BenchResult>> results;
+
+	for (const BenchScene& scene : BENCH_SCENES) {
+		if (sceneFilter && std::string_view(scene.name) != sceneFilter)
+			continue;
+
+		fmt::println("Running {} for {} frames", scene.name, frames);
+		results.push_back({scene.name, runScene(scene, frames)});
+	}
+
+	for (const auto& [scene, result] : results) {
+		fmt::print("{}:", scene);
+		for (const auto& [metric, value] : result) {
+			if (metric.starts_with("cpuFrameMs") || metric == "gpuFrameMs.avg")
+				fmt::print(" {} {:.3f}", metric, value);
+		}
+		fmt::println("");
+	}
+
+	if (writeResults(outputPath, results) != VK_SUCCESS) {
+		fmt::println("Failed to write the results to {}", outputPath);
+		return 1;
+	}
+
+	fmt::println("Results written to {}", outputPath);
+
+	if (!baselinePath)
+		return 0;
+
+	uint32_t regressions = compareResults(results, baseline, threshold);
+	fmt::println("{} regressions against {}", regressions, baselinePath);
+
+	return regressions ? 2 : 0;
+}
@@ -0,0 +1,95 @@
+#include "renderer/vke_utils.hpp"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+
+using namespace vke;
+
+// push and flush throughput of the typed deletion queue against the std::function one it replaced, one queue per frame
+// like FrameData::_deletionQueue; the entries free geometry arena ranges, so both queues do the same CPU-only work
+constexpr uint32_t FRAMES = 1000;
+constexpr uint32_t ENTRIES_PER_FRAME = 1000;
+
+// the previous vkutil::DeletionQueue, deletors copied in and called in reverse
+struct FunctionDeletionQueue {
+	std::deque<std::function<void()>> deletors;
+
+	void push_function(std::function<void()>&& deletor) { deletors.push_back(deletor); }
+
+	void flush() {
+		for (auto it = deletors.rbegin(); it != deletors.rend(); it++)
+			(*it)();
+		deletors.clear();
+	}
+};
+
+struct Timings {
+	double pushMs;
+	double flushMs;
+};
+
+static void allocateRanges(VkeRangeAllocator& ranges, std::vector<uint64_t>& offsets) {
+	for (uint32_t i = 0; i < ENTRIES_PER_FRAME; i++)
+		ranges.allocate(1 + i % 16, &offsets[i]);
+}
+
+template <typename Push, typename Flush>
+static Timings measure(VkeRangeAllocator& ranges, Push&& push, Flush&& flush) {
+	std::vector<uint64_t> offsets(ENTRIES_PER_FRAME);
+	std::chrono::duration<double, std::milli> pushTime{0}, flushTime{0};
+
+	for (uint32_t frame = 0; frame < FRAMES; frame++) {
+		allocateRanges(ranges, offsets);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < ENTRIES_PER_FRAME; i++)
+			push(offsets[i], 1 + i % 16);
+
+		auto pushed = std::chrono::high_resolution_clock::now();
+		flush();
+
+		pushTime += pushed - start;
+		flushTime += std::chrono::high_resolution_clock::now() - pushed;
+	}
+
+	return {pushTime.count(), flushTime.count()};
+}
+
+static void report(const char* name, Timings timings, VkeRangeAllocator& ranges) {
+	double entries = (double)FRAMES * ENTRIES_PER_FRAME;
+
+	// every range back in the allocator
+	bool valid = ranges.getStats().used == 0;
+
+	fmt::println("{:<16} push {:8.2f} ms {:6.1f} ns/entry, flush {:8.2f} ms {:6.1f} ns/entry{}", name, timings.pushMs,
+				 timings.pushMs * 1e6 / entries, timings.flushMs, timings.flushMs * 1e6 / entries,
+				 valid ? "" : "  WRONG RESULT");
+}
+
+int main() {
+	fmt::println("{} frames of {} deletions", FRAMES, ENTRIES_PER_FRAME);
+
+	VkeRangeAllocator ranges;
+	ranges.init(ENTRIES_PER_FRAME * 16);
+
+	// flushes only ever destroy ranges, no device or allocator is touched
+	FunctionDeletionQueue functionQueue;
+	Timings functionTimings = measure(
+		ranges,
+		[&](uint64_t offset, uint32_t size) {
+			functionQueue.push_function([&ranges, offset, size] { ranges.free(offset, size); });
+		},
+		[&] { functionQueue.flush(); });
+	report("std::function", functionTimings, ranges);
+
+	vkutil::DeletionQueue typedQueue;
+	Timings typedTimings = measure(
+		ranges, [&](uint64_t offset, uint32_t size) { typedQueue.pushRange(ranges, offset, size); },
+		[&] { typedQueue.flush(VK_NULL_HANDLE, VK_NULL_HANDLE); });
+	report("typed", typedTimings, ranges);
+
+	return 0;
+}
@@ -0,0 +1,249 @@
+#include "vke_job_system.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <queue>
+
+using namespace vke;
+
+// scheduling overhead of tiny jobs: each one only adds its index to a slot, so the time is what the scheduler costs;
+// the shared queue is how work used to be handed to threads, one mutex and condition variable for everything
+constexpr uint32_t JOB_COUNT = 1'000'000;
+constexpr uint32_t SPAWNERS = 1000; // jobs that each submit JOB_COUNT / SPAWNERS jobs of their own
+constexpr uint32_t STAGES = 1000;	// chained with runAfter, JOB_COUNT / STAGES jobs each
+constexpr uint32_t MAIN_THREAD_JOBS = 1000;
+
+class SharedQueuePool {
+public:
+	void init(uint32_t threadCount) {
+		for (uint32_t i = 0; i < threadCount; i++)
+			m_workers.emplace_back(&SharedQueuePool::workerLoop, this);
+	}
+
+	void destroy() {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+
+		m_taskAvailable.notify_all();
+
+		for (std::thread& worker : m_workers)
+			worker.join();
+	}
+
+	void submit(std::function<void()>&& task) {
+		{
+			std::lock_guard lock(m_mutex);
+			m_tasks.push(std::move(task));
+		}
+
+		m_taskAvailable.notify_one();
+	}
+
+	void waitIdle() {
+		std::unique_lock lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_tasks.empty() && m_running == 0; });
+	}
+
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskAvailable;
+	std::condition_variable m_idle;
+	uint32_t m_running{0};
+	bool m_stopping{false};
+
+	void workerLoop() {
+		while (true) {
+			std::function<void()> task;
+
+			{
+				std::unique_lock lock(m_mutex);
+				m_taskAvailable.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+				if (m_tasks.empty())
+					return;
+
+				task = std::move(m_tasks.front());
+				m_tasks.pop();
+				m_running++;
+			}
+
+			task();
+
+			std::lock_guard lock(m_mutex);
+			m_running--;
+
+			if (m_tasks.empty() && m_running == 0)
+				m_idle.notify_all();
+		}
+	}
+};
+
+template <typename F>
+static double measureMs(F&& function) {
+	auto start = std::chrono::high_resolution_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void report(const char* name, double ms, const std::vector<uint64_t>& slots) {
+	uint64_t total = 0;
+	for (uint64_t slot : slots)
+		total += slot;
+
+	// every index added once
+	bool valid = total == (uint64_t)JOB_COUNT * (JOB_COUNT - 1) / 2;
+
+	fmt::println("{:<32} {:9.2f} ms {:8.1f} ns/job{}", name, ms, ms * 1e6 / JOB_COUNT, valid ? "" : "  WRONG RESULT");
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t cores = std::thread::hardware_concurrency();
+	uint32_t workers = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : (cores > 1 ? cores - 1 : 1);
+
+	fmt::println("{} tiny jobs, {} workers and the main thread", JOB_COUNT, workers);
+
+	// one slot per worker group, so the jobs do not all fight over the same cache line
+	std::vector<uint64_t> slots(64 * 8);
+	auto addIndex = [&slots](uint32_t index) {
+		std::atomic_ref<uint64_t>(slots[(index % 64) * 8]).fetch_add(index, std::memory_order_relaxed);
+	};
+
+	double serialMs = measureMs([&] {
+		for (uint32_t i = 0; i < JOB_COUNT; i++)
+			addIndex(i);
+	});
+	report("serial loop", serialMs, slots);
+
+	{
+		SharedQueuePool pool;
+		pool.init(workers);
+
+		std::fill(slots.begin(), slots.end(), 0);
+		double ms = measureMs([&] {
+			for (uint32_t i = 0; i < JOB_COUNT; i++)
+				pool.submit([&addIndex, i] { addIndex(i); });
+			pool.waitIdle();
+		});
+		report("shared queue, main submits", ms, slots);
+
+		pool.destroy();
+	}
+
+	VkeJobSystem jobs;
+	jobs.init(workers);
+
+	std::fill(slots.begin(), slots.end(), 0);
+	double mainMs = measureMs([&] {
+		VkeJobCounter counter;
+		for (uint32_t i = 0; i < JOB_COUNT; i++)
+			jobs.run([&addIndex, i] { addIndex(i); }, &counter);
+		jobs.wait(counter);
+	});
+	report("job system, main submits", mainMs, slots);
+
+	// submitted from the workers' own deques, the others steal
+	std::fill(slots.begin(), slots.end(), 0);
+	double nestedMs = measureMs([&] {
+		VkeJobCounter counter;
+		for (uint32_t spawner = 0; spawner < SPAWNERS; spawner++) {
+			jobs.run(
+				[&jobs, &addIndex, &counter, spawner] {
+					uint32_t count = JOB_COUNT / SPAWNERS;
+					for (uint32_t i = spawner * count; i < (spawner + 1) * count; i++)
+						jobs.run([&addIndex, i] { addIndex(i); }, &counter);
+				},
+				&counter);
+		}
+		jobs.wait(counter);
+	});
+	report("job system, jobs submit", nestedMs, slots);
+
+	std::fill(slots.begin(), slots.end(), 0);
+	double forMs = measureMs([&] {
+		jobs.parallelFor(0, JOB_COUNT, 1, [&addIndex](uint32_t first, uint32_t last) { addIndex(first); });
+	});
+	report("parallelFor, grain 1", forMs, slots);
+
+	std::fill(slots.begin(), slots.end(), 0);
+	double chunkedMs = measureMs([&] {
+		jobs.parallelFor(0, JOB_COUNT, 1024, [&addIndex](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+				addIndex(i);
+		});
+	});
+	report("parallelFor, grain 1024", chunkedMs, slots);
+
+	// every stage only starts once the previous one is done
+	std::fill(slots.begin(), slots.end(), 0);
+	std::atomic<uint32_t> outOfOrder{0};
+	double chainedMs = measureMs([&] {
+		uint32_t count = JOB_COUNT / STAGES;
+		auto counters = std::make_unique<VkeJobCounter[]>(STAGES);
+		auto completed = std::make_unique<std::atomic<uint32_t>[]>(STAGES);
+
+		for (uint32_t stage = 0; stage < STAGES; stage++) {
+			for (uint32_t i = stage * count; i < (stage + 1) * count; i++) {
+				auto job = [&, stage, i, count] {
+					if (stage > 0 && completed[stage - 1].load() != count)
+						outOfOrder++;
+
+					addIndex(i);
+					completed[stage]++;
+				};
+
+				if (stage == 0)
+					jobs.run(job, &counters[stage]);
+				else
+					jobs.runAfter(counters[stage - 1], job, &counters[stage]);
+			}
+		}
+
+		// each one, a counter may only go away once a wait on it returned
+		for (uint32_t stage = 0; stage < STAGES; stage++)
+			jobs.wait(counters[stage]);
+	});
+	report("runAfter, chained stages", chainedMs, slots);
+
+	if (outOfOrder)
+		fmt::println("  {} jobs started before the stage they depend on was done", outOfOrder.load());
+
+	// workers hand the second half of their work to the main thread
+	std::atomic<uint32_t> offMainThread{0};
+	std::atomic<uint32_t> mainThreadRuns{0};
+	double mainThreadMs = measureMs([&] {
+		VkeJobCounter counter;
+		for (uint32_t i = 0; i < MAIN_THREAD_JOBS; i++) {
+			jobs.run(
+				[&] {
+					jobs.runOnMainThread(
+						[&] {
+							if (!jobs.isMainThread())
+								offMainThread++;
+							mainThreadRuns++;
+						},
+						&counter);
+				},
+				&counter);
+		}
+		jobs.wait(counter);
+	});
+
+	fmt::println("{:<32} {:9.2f} ms {:8.1f} ns/job{}", "runOnMainThread, from jobs", mainThreadMs,
+				 mainThreadMs * 1e6 / MAIN_THREAD_JOBS,
+				 mainThreadRuns == MAIN_THREAD_JOBS && offMainThread == 0 ? "" : "  WRONG RESULT");
+
+	VkeJobSystem::Stats stats = jobs.getStats();
+	fmt::println("{} jobs run, {} stolen", stats.jobs, stats.steals);
+
+	jobs.destroy();
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "renderer/vke_device.hpp"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cmath>
+#include <numbers>
+
+using namespace vke;
+
+// uploads 10k small meshes into the geometry arena, against a pair of dedicated buffers per mesh like uploadMesh
+// used to create, both in one upload batch; then frees every other mesh and uploads them again into the holes
+constexpr uint32_t MESH_COUNT = 10000;
+
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// fans with a different vertex count each, so the arena ranges differ in size
+static MeshData makeFan(uint32_t sides) {
+	MeshData mesh;
+	mesh.vertices.resize(sides + 1);
+	mesh.vertices[0] = {.color = {1.f, 1.f, 1.f, 1.f}};
+
+	for (uint32_t side = 0; side < sides; side++) {
+		float angle = 2.f * std::numbers::pi_v<float> * side / sides;
+		mesh.vertices[side + 1] = {.position = {std::cos(angle), std::sin(angle), 0.f}, .color = {1.f, 1.f, 1.f, 1.f}};
+		mesh.indices.insert(mesh.indices.end(), {0, side + 1, (side + 1) % sides + 1});
+	}
+
+	return mesh;
+}
+
+template <typename F>
+static double measureMs(F&& function) {
+	auto start = std::chrono::high_resolution_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void printArena(VkeDevice& device) {
+	VkeRangeAllocator::Stats vertexStats, indexStats;
+	device.getGeometryArenaStats(&vertexStats, &indexStats);
+
+	fmt::println("  arena vertices: {} used in {} ranges, {} free ranges, fragmentation {:.3f}", vertexStats.used,
+				 vertexStats.allocations, vertexStats.freeRanges, vertexStats.fragmentation);
+	fmt::println("  arena indices:  {} used in {} ranges, {} free ranges, fragmentation {:.3f}", indexStats.used,
+				 indexStats.allocations, indexStats.freeRanges, indexStats.fragmentation);
+}
+
+int main() {
+	std::vector<MeshData> meshData;
+	for (uint32_t i = 0; i < MESH_COUNT; i++)
+		meshData.push_back(makeFan(3 + i % 29));
+
+	VkeJobSystem jobSystem;
+	jobSystem.init(1);
+
+	VkeDevice device;
+	VK_CHECK(device.init(nullptr, &jobSystem));
+
+	uint32_t baseAllocations = device.getMemoryStats().allocations;
+
+	// dedicated buffers, created, filled and destroyed the way uploadMesh did before the arena
+	std::vector<AllocatedBuffer> dedicated(MESH_COUNT * 2);
+	uint32_t dedicatedAllocations = 0;
+	double dedicatedMs = measureMs([&] {
+		device.beginUploadBatch();
+
+		for (uint32_t i = 0; i < MESH_COUNT; i++) {
+			MeshData& mesh = meshData[i];
+			size_t vertexSize = mesh.vertices.size() * sizeof(Vertex);
+			size_t indexSize = mesh.indices.size() * sizeof(uint32_t);
+
+			VK_CHECK(device.createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+										 VMA_MEMORY_USAGE_GPU_ONLY, &dedicated[i * 2], true));
+			VK_CHECK(device.createBuffer(vertexSize,
+										 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+											 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+										 VMA_MEMORY_USAGE_GPU_ONLY, &dedicated[i * 2 + 1], true));
+
+			VK_CHECK(device.stageBuffer(dedicated[i * 2].buffer, 0, mesh.indices.data(), indexSize));
+			VK_CHECK(device.stageBuffer(dedicated[i * 2 + 1].buffer, 0, mesh.vertices.data(), vertexSize));
+		}
+
+		VK_CHECK(device.endUploadBatch());
+		dedicatedAllocations = device.getMemoryStats().allocations - baseAllocations;
+	});
+
+	for (AllocatedBuffer& buffer : dedicated)
+		device.destroyBuffer(&buffer);
+
+	fmt::println("dedicated buffers: {:9.2f} ms, {} allocations", dedicatedMs, dedicatedAllocations);
+
+	std::vector<GPUMeshBuffers> meshes(MESH_COUNT);
+	double arenaMs = measureMs([&] {
+		device.beginUploadBatch();
+
+		for (uint32_t i = 0; i < MESH_COUNT; i++)
+			VK_CHECK(device.uploadMesh(&meshes[i], meshData[i].indices, meshData[i].vertices));
+
+		VK_CHECK(device.endUploadBatch());
+	});
+
+	fmt::println("geometry arena:    {:9.2f} ms, {} allocations", arenaMs,
+				 device.getMemoryStats().allocations - baseAllocations);
+	printArena(device);
+
+	// the ranges only return to the arena when the queue is flushed, i.e. once no frame draws the meshes anymore
+	vkutil::DeletionQueue deletionQueue;
+	for (uint32_t i = 0; i < MESH_COUNT; i += 2)
+		VK_CHECK(device.destroyMesh(&meshes[i], deletionQueue));
+
+	device.waitIdle();
+	device.flushDeletionQueue(deletionQueue);
+
+	fmt::println("every other mesh freed:");
+	printArena(device);
+
+	double refillMs = measureMs([&] {
+		device.beginUploadBatch();
+
+		for (uint32_t i = 0; i < MESH_COUNT; i += 2)
+			VK_CHECK(device.uploadMesh(&meshes[i], meshData[i].indices, meshData[i].vertices));
+
+		VK_CHECK(device.endUploadBatch());
+	});
+
+	fmt::println("refilled the holes: {:8.2f} ms", refillMs);
+	printArena(device);
+
+	device.waitIdle();
+	jobSystem.destroy();
+	device.destroy();
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include "vke_range_allocator.hpp"
+
+#include <fmt/core.h>
+
+#include <random>
+#include <vector>
+
+using namespace vke;
+
+// CPU-side checks of the geometry arena allocator, the exit code is the number of failed checks
+static uint32_t g_failures = 0;
+
+static void check(bool condition, const char* what) {
+	if (condition)
+		return;
+
+	fmt::println("FAILED: {}", what);
+	g_failures++;
+}
+
+static void testFirstFit() {
+	VkeRangeAllocator ranges;
+	ranges.init(100);
+
+	uint64_t a, b, c;
+	check(ranges.allocate(10, &a) && a == 0, "first allocation starts at 0");
+	check(ranges.allocate(20, &b) && b == 10, "allocations are packed");
+	check(ranges.allocate(70, &c) && c == 30, "the last range fills the capacity");
+
+	uint64_t unused;
+	check(!ranges.allocate(1, &unused), "a full allocator refuses");
+	check(!ranges.allocate(0, &unused), "empty ranges are refused");
+
+	// the first free range large enough wins, even when a later one fits better
+	ranges.free(a, 10);
+	ranges.free(c, 70);
+	uint64_t d;
+	check(ranges.allocate(5, &d) && d == 0, "first fit takes the lowest range");
+
+	VkeRangeAllocator::Stats stats = ranges.getStats();
+	check(stats.used == 25 && stats.allocations == 2, "used space and allocation count");
+}
+
+static void testCoalescing() {
+	VkeRangeAllocator ranges;
+	ranges.init(30);
+
+	uint64_t a, b, c;
+	ranges.allocate(10, &a);
+	ranges.allocate(10, &b);
+	ranges.allocate(10, &c);
+
+	ranges.free(a, 10);
+	ranges.free(c, 10);
+	check(ranges.getStats().freeRanges == 2, "separated ranges stay apart");
+	check(ranges.getStats().fragmentation > 0.f, "split free space is fragmented");
+
+	// merges with both neighbours at once
+	ranges.free(b, 10);
+	VkeRangeAllocator::Stats stats = ranges.getStats();
+	check(stats.freeRanges == 1 && stats.largestFreeRange == 30, "freed neighbours coalesce");
+	check(stats.fragmentation == 0.f && stats.used == 0, "an empty allocator is not fragmented");
+
+	uint64_t all;
+	check(ranges.allocate(30, &all) && all == 0, "the whole capacity is usable again");
+}
+
+// random allocations and frees against an ownership map, no two live ranges may overlap
+static void testRandom() {
+	constexpr uint64_t CAPACITY = 1 << 16;
+
+	VkeRangeAllocator ranges;
+	ranges.init(CAPACITY);
+
+	struct Range {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	std::vector<Range> live;
+	std::vector<bool> owned(CAPACITY, false);
+	std::mt19937 random(1234);
+
+	bool overlap = false;
+	uint64_t used = 0;
+
+	for (uint32_t i = 0; i < 100000; i++) {
+		if (live.empty() || random() % 3 != 0) {
+			uint64_t size = 1 + random() % 256;
+			uint64_t offset;
+			if (!ranges.allocate(size, &offset))
+				continue;
+
+			if (offset + size > CAPACITY) {
+				overlap = true;
+				break;
+			}
+
+			for (uint64_t j = offset; j < offset + size; j++) {
+				overlap |= owned[j];
+				owned[j] = true;
+			}
+
+			live.push_back({offset, size});
+			used += size;
+		} else {
+			size_t index = random() % live.size();
+			Range range = live[index];
+			live[index] = live.back();
+			live.pop_back();
+
+			for (uint64_t j = range.offset; j < range.offset + range.size; j++)
+				owned[j] = false;
+
+			ranges.free(range.offset, range.size);
+			used -= range.size;
+		}
+	}
+
+	check(!overlap, "live ranges stay inside the capacity and never overlap");
+	check(ranges.getStats().used == used, "used space matches the live ranges");
+
+	for (Range& range : live)
+		ranges.free(range.offset, range.size);
+
+	VkeRangeAllocator::Stats stats = ranges.getStats();
+	check(stats.freeRanges == 1 && stats.largestFreeRange == CAPACITY, "freeing everything restores one range");
+}
+
+int main() {
+	testFirstFit();
+	testCoalescing();
+	testRandom();
+
+	if (g_failures == 0)
+		fmt::println("All range allocator checks passed");
+
+	return (int)g_failures;
+}
@@ -0,0 +1,156 @@
+#include "vke_shader_archive.hpp"
+#include "vke_utils.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+using namespace vke;
+
+// startup cost of loading many shaders: loose .spv files read and reflected one by one, against the mapped archive
+// with its reflection stored; both create the same modules, once for every shader and once for the few a scene uses
+constexpr uint32_t SHADER_COUNT = 500;
+constexpr uint32_t USED_SHADERS = 16;
+
+static VkResult createModule(VkDevice device, std::span<const uint32_t> code, VkShaderModule* module) {
+	VkShaderModuleCreateInfo createInfo = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = code.size_bytes(),
+		.pCode = code.data(),
+	};
+
+	return vkCreateShaderModule(device, &createInfo, nullptr, module);
+}
+
+static double loadLooseFiles(VkDevice device, const std::vector<std::string>& paths, uint32_t moduleCount) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<VkShaderModule> modules(moduleCount);
+	for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+		std::vector<uint32_t> shaderCode;
+		VK_CHECK(vkutil::readSpirv(paths[i].c_str(), &shaderCode));
+
+		VkeShaderReflection reflection;
+		VK_CHECK(vkutil::reflectShader(shaderCode, &reflection));
+
+		if (i < moduleCount)
+			VK_CHECK(createModule(device, shaderCode, &modules[i]));
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	for (VkShaderModule module : modules)
+		vkDestroyShaderModule(device, module, nullptr);
+
+	return elapsed.count();
+}
+
+static double loadArchive(VkDevice device, const std::string& archivePath, uint32_t moduleCount) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	VkeShaderArchive archive;
+	VK_CHECK(archive.open(archivePath.c_str()));
+
+	std::vector<VkeShader> shaders(SHADER_COUNT);
+	for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+		const ShaderArchiveEntry* entry = archive.find(fmt::format("shader_{}.spv", i));
+		if (!entry) {
+			fmt::println("shader_{}.spv is missing from the archive", i);
+			std::exit(1);
+		}
+
+		VK_CHECK(archive.getShader(*entry, &shaders[i]));
+	}
+
+	// what the device does on first pipeline use, checksum included
+	std::vector<VkShaderModule> modules(moduleCount);
+	for (uint32_t i = 0; i < moduleCount; i++) {
+		std::span<const uint32_t> shaderCode = shaders[i].getCode();
+
+		if (vkutil::hashBytes(shaderCode.data(), shaderCode.size_bytes()) != shaders[i].getHash()) {
+			fmt::println("shader_{}.spv does not match its checksum", i);
+			std::exit(1);
+		}
+
+		VK_CHECK(createModule(device, shaderCode, &modules[i]));
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	for (VkShaderModule module : modules)
+		vkDestroyShaderModule(device, module, nullptr);
+
+	archive.close();
+
+	return elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+	const char* source = argc > 1 ? argv[1] : "shaders/basic.frag.spv";
+
+	std::vector<uint32_t> code;
+	if (vkutil::readSpirv(source, &code) != VK_SUCCESS || code.size() < 5) {
+		fmt::println("usage: {} [shader.spv]", argv[0]);
+		return 1;
+	}
+
+	// headless, the modules are real so the driver cost is part of the numbers
+	vkb::InstanceBuilder builder;
+	auto instRet = builder.set_app_name("Shader Bench").set_headless().require_api_version(1, 3, 0).build();
+	if (!instRet) {
+		fmt::println("Failed to create the instance: {}", instRet.error().message());
+		return 1;
+	}
+
+	vkb::PhysicalDeviceSelector selector{instRet.value()};
+	auto physRet = selector.set_minimum_version(1, 3).require_present(false).select();
+	if (!physRet) {
+		fmt::println("Failed to select a GPU: {}", physRet.error().message());
+		return 1;
+	}
+
+	vkb::DeviceBuilder deviceBuilder{physRet.value()};
+	auto deviceRet = deviceBuilder.build();
+	if (!deviceRet) {
+		fmt::println("Failed to create the device: {}", deviceRet.error().message());
+		return 1;
+	}
+
+	VkDevice device = deviceRet.value().device;
+
+	// the variants only differ in the generator word of the header, enough to give each its own hash
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "vke_shader_bench";
+	std::filesystem::create_directories(dir);
+
+	std::vector<std::string> paths;
+	for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+		code[2] = (code[2] & 0xFFFF0000) | i;
+
+		paths.push_back((dir / fmt::format("shader_{}.spv", i)).string());
+
+		std::ofstream file(paths.back(), std::ios::binary | std::ios::trunc);
+		file.write((const char*)code.data(), code.size() * sizeof(uint32_t));
+	}
+
+	std::string archivePath = (dir / "shaders.pak").string();
+	VK_CHECK(vkutil::writeShaderArchive(archivePath, paths));
+
+	fmt::println("{} shaders, page cache warm for both", SHADER_COUNT);
+
+	for (uint32_t moduleCount : {SHADER_COUNT, USED_SHADERS}) {
+		double looseMs = loadLooseFiles(device, paths, moduleCount);
+		double archiveMs = loadArchive(device, archivePath, moduleCount);
+
+		fmt::println("{} modules created", moduleCount);
+		fmt::println("  loose files: {:.2f} ms", looseMs);
+		fmt::println("  archive:     {:.2f} ms", archiveMs);
+	}
+
+	vkb::destroy_device(deviceRet.value());
+	vkb::destroy_instance(instRet.value());
+
+	std::filesystem::remove_all(dir);
+
+	return 0;
+}
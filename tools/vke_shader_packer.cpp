@@ -0,0 +1,20 @@
+#include "vke_shader_archive.hpp"
+
+// packs the compiled shaders into the archive mapped by the engine at startup
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		fmt::println("usage: {} <archive> <shader.spv>...", argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> shaders(argv + 2, argv + argc);
+
+	if (vkutil::writeShaderArchive(argv[1], shaders) != VK_SUCCESS) {
+		fmt::println("Failed to pack the shaders into {}", argv[1]);
+		return 1;
+	}
+
+	fmt::println("Packed {} shaders into {}", shaders.size(), argv[1]);
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "renderer/vke_device.hpp"
+
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/parser.hpp>
+#include <fastgltf/tools.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+using namespace vke;
+
+// load time of the meshes in a glTF file replicated COPIES times, against how many uploads share a batch;
+// a batch size of 1 is what every upload cost before batches, one submit and wait each
+constexpr uint32_t COPIES = 200; // basicmesh.glb is about 4k vertices, the geometry arena holds 1M
+constexpr uint32_t BATCH_SIZES[] = {1, 8, 64, 512, UINT32_MAX};
+
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// every primitive of a mesh ends up in one MeshData, like the demo draws them
+static bool loadMeshes(const std::filesystem::path& path, std::vector<MeshData>* meshes) {
+	fastgltf::GltfDataBuffer data;
+	data.loadFromFile(path);
+
+	fastgltf::Parser parser;
+	auto load = parser.loadBinaryGLTF(&data, path.parent_path(),
+									  fastgltf::Options::LoadGLBBuffers | fastgltf::Options::LoadExternalBuffers);
+	if (!load)
+		return false;
+
+	fastgltf::Asset gltf = std::move(load.get());
+
+	for (fastgltf::Mesh& mesh : gltf.meshes) {
+		MeshData& meshData = meshes->emplace_back();
+
+		for (fastgltf::Primitive& primitive : mesh.primitives) {
+			size_t firstVertex = meshData.vertices.size();
+
+			fastgltf::Accessor& indexAccessor = gltf.accessors[primitive.indicesAccessor.value()];
+			fastgltf::iterateAccessor<uint32_t>(gltf, indexAccessor, [&](uint32_t index) {
+				meshData.indices.push_back((uint32_t)firstVertex + index);
+			});
+
+			fastgltf::Accessor& positionAccessor = gltf.accessors[primitive.findAttribute("POSITION")->second];
+			meshData.vertices.resize(firstVertex + positionAccessor.count, {.color = {1.f, 1.f, 1.f, 1.f}});
+			fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, positionAccessor, [&](glm::vec3 position, size_t index) {
+				meshData.vertices[firstVertex + index].position = position;
+			});
+
+			if (auto normals = primitive.findAttribute("NORMAL"); normals != primitive.attributes.end()) {
+				fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[normals->second],
+															  [&](glm::vec3 normal, size_t index) {
+																  meshData.vertices[firstVertex + index].normal = normal;
+															  });
+			}
+
+			if (auto uvs = primitive.findAttribute("TEXCOORD_0"); uvs != primitive.attributes.end()) {
+				fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[uvs->second], [&](glm::vec2 uv, size_t index) {
+					meshData.vertices[firstVertex + index].uv_x = uv.x;
+					meshData.vertices[firstVertex + index].uv_y = uv.y;
+				});
+			}
+		}
+	}
+
+	return true;
+}
+
+template <typename F>
+static double measureMs(F&& function) {
+	auto start = std::chrono::high_resolution_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	std::filesystem::path path = argc > 1 ? argv[1] : "assets/basicmesh.glb";
+
+	std::vector<MeshData> meshData;
+	if (!loadMeshes(path, &meshData) || meshData.empty()) {
+		fmt::println("Cannot load the meshes of {}", path.string());
+		return 1;
+	}
+
+	uint32_t meshCount = (uint32_t)meshData.size() * COPIES;
+	fmt::println("{} meshes of {} replicated {} times, {} uploads", meshData.size(), path.string(), COPIES, meshCount);
+
+	VkeJobSystem jobSystem;
+	jobSystem.init(1);
+
+	VkeDevice device;
+	VK_CHECK(device.init(nullptr, &jobSystem));
+
+	std::vector<GPUMeshBuffers> meshes(meshCount);
+	vkutil::DeletionQueue deletionQueue;
+
+	for (uint32_t batchSize : BATCH_SIZES) {
+		uint32_t size = std::min(batchSize, meshCount);
+		uint32_t stallsBefore = device.getStagingStats().stallsTotal;
+
+		double ms = measureMs([&] {
+			for (uint32_t first = 0; first < meshCount; first += size) {
+				device.beginUploadBatch();
+
+				for (uint32_t i = first; i < std::min(first + size, meshCount); i++) {
+					MeshData& mesh = meshData[i % meshData.size()];
+					VK_CHECK(device.uploadMesh(&meshes[i], mesh.indices, mesh.vertices));
+				}
+
+				VK_CHECK(device.endUploadBatch());
+			}
+		});
+
+		// a full staging ring submits early, on top of the one submission per batch
+		fmt::println("batch size {:>5}: {:9.2f} ms, {:7.1f} us per mesh, {} batches, {} ring stalls", size, ms,
+					 ms * 1e3 / meshCount, (meshCount + size - 1) / size, device.getStagingStats().stallsTotal - stallsBefore);
+
+		// the next batch size starts from an empty arena
+		for (GPUMeshBuffers& mesh : meshes)
+			VK_CHECK(device.destroyMesh(&mesh, deletionQueue));
+
+		device.waitIdle();
+		device.flushDeletionQueue(deletionQueue);
+	}
+
+	device.waitIdle();
+	jobSystem.destroy();
+	device.destroy();
+
+	return 0;
+}